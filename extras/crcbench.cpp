@@ -0,0 +1,167 @@
+/**
+ * SVM30 frame codec micro benchmark
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * Compares decoding a response with the bitwise CRC of the original
+ * driver (CalcCrC() and the receive buffer) against the table CRC and
+ * svm30_frame<N> of svm30frame.h. It first checks that both CRC versions
+ * give the same result for every possible data word.
+ *
+ * Build with : make crcbench
+ * Run        : ./crcbench [frames]     (default 10000000)
+ *********************************************************************
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include "../svm30frame.h"
+
+/* words in the benchmark response (as Measure_Air_Quality) */
+#define WORDS 2
+
+/* keeps the compiler from removing the decode loops */
+volatile uint16_t Sink;
+
+/**
+ * @brief : calculate CRC for I2c comms, as the original driver did
+ * @param data : 2 databytes to calculate the CRC from
+ *
+ * return CRC
+ */
+static uint8_t CalcCrC(const uint8_t *data) {
+    uint8_t crc = 0xFF;
+    for(int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for(uint8_t bit = 8; bit > 0; --bit) {
+            if(crc & 0x80) {
+                crc = (crc << 1) ^ 0x31u;
+            } else {
+                crc = (crc << 1);
+            }
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief : decode a response as the original driver did : check each
+ * word with CalcCrC(), copy it into the receive buffer and combine the
+ * bytes from there.
+ *
+ * @return : true if all CRC were correct
+ */
+static bool decode_old(const uint8_t *raw, uint16_t *w) {
+    uint8_t buf[WORDS * 2], len = 0, i;
+
+    for (i = 0; i < WORDS * 3; i += 3) {
+        if (raw[i + 2] != CalcCrC(&raw[i])) return(false);
+        buf[len++] = raw[i];
+        buf[len++] = raw[i + 1];
+    }
+
+    for (i = 0; i < WORDS; i++) w[i] = buf[i * 2] << 8 | buf[i * 2 + 1];
+
+    return(true);
+}
+
+/**
+ * @brief : decode a response with the frame codec
+ *
+ * @return : true if all CRC were correct
+ */
+static bool decode_new(const svm30_frame<WORDS> *f, uint16_t (&w)[WORDS]) {
+    if (svm30_crc_check(f->raw, WORDS) != WORDS) return(false);
+    f->Decode(w);
+    return(true);
+}
+
+/**
+ * @brief : get monotonic time in nS
+ */
+static uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+    svm30_frame<WORDS> f[256];
+    uint16_t w[WORDS] = {0};
+    uint32_t frames = 10000000, i, errors = 0;
+    uint64_t start, t_old, t_new;
+    uint8_t d[2];
+
+    if (argc > 1) frames = strtoul(argv[1], NULL, 0);
+    if (frames == 0) frames = 1;
+
+    // both CRC versions must agree on every data word
+    for (i = 0; i < 0x10000; i++) {
+        d[0] = i >> 8;
+        d[1] = i & 0xff;
+        if (CalcCrC(d) != svm30_crc8(d)) errors++;
+    }
+
+    if (errors) {
+        printf("CRC mismatch on %u data words\n", errors);
+        return(EXIT_FAILURE);
+    }
+
+    // frames with different data and correct CRC
+    for (i = 0; i < 256; i++) {
+        for (uint8_t j = 0; j < WORDS; j++) {
+            f[i].raw[j * 3] = i;
+            f[i].raw[j * 3 + 1] = i * 7 + j;
+            f[i].raw[j * 3 + 2] = CalcCrC(&f[i].raw[j * 3]);
+        }
+    }
+
+    start = now_ns();
+    for (i = 0; i < frames; i++) {
+        if (! decode_old(f[i & 0xff].raw, w)) errors++;
+        Sink = w[0] + w[WORDS - 1];
+    }
+    t_old = now_ns() - start;
+
+    start = now_ns();
+    for (i = 0; i < frames; i++) {
+        if (! decode_new(&f[i & 0xff], w)) errors++;
+        Sink = w[0] + w[WORDS - 1];
+    }
+    t_new = now_ns() - start;
+
+    if (errors) printf("%u CRC errors during decode\n", errors);
+
+    printf("Decoding %u frames of %d words\n", frames, WORDS);
+    printf("bitwise CRC : %6.1f nS per frame\n", (double) t_old / frames);
+    printf("table CRC   : %6.1f nS per frame\n", (double) t_new / frames);
+
+    return(errors ? EXIT_FAILURE : EXIT_SUCCESS);
+}
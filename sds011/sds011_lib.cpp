@@ -392,6 +392,45 @@ int SDS::Report_Data(uint8_t rmode, float *PM25, float *PM10)
     return(SDS011_OK);
 }
 
+/*********************************************************************
+ * @brief : request data when in query mode, without reading the response
+ *
+ * @return :
+ *  SDS011_ERROR : could not send command
+ *  SDS011_OK    : all good
+ *********************************************************************/
+int SDS::Query_request()
+{
+    prepare_packet(SDS011_QDATA);
+
+    if (_sdsDebug) printf("\n\tQuery for data\n");
+
+    return(send_sds());
+}
+
+/*********************************************************************
+ * @brief : decode a response that was read by the caller
+ *
+ * @param packet : SDS011_PACKET_LEN bytes received
+ * @param PM25 : to store the measured PM2.5 value
+ * @param PM10 : to store the measured PM10 value
+ *
+ * @return :
+ *  SDS011_ERROR : not a valid data packet
+ *  SDS011_OK    : all good
+ *********************************************************************/
+int SDS::Decode_data(const uint8_t *packet, float *PM25, float *PM10)
+{
+    if (ProcessResponse(packet, SDS011_PACKET_LEN) == SDS011_ERROR) return(SDS011_ERROR);
+
+    if (data.cmd_id != SDS011_DATA) return(SDS011_ERROR);
+
+    *PM25 = data.pm25;
+    *PM10 = data.pm10;
+
+    return(SDS011_OK);
+}
+
 /*********************************************************************
  * @brief : read firmware version
  * 
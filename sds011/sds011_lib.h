@@ -227,6 +227,29 @@ class   SDS
     int Get_data(float *PM25, float *PM10)
         {return(Report_Data(REPORT_STREAM, PM25, PM10));}
 
+    /**
+     * @brief : request data when in query mode, without reading the
+     * response (see Decode_data())
+     *
+     * @return :
+     *  SDS011_ERROR : could not send command
+     *  SDS011_OK    : all good
+     */
+    int Query_request();
+
+    /**
+     * @brief : decode a response that was read by the caller
+     *
+     * @param packet : SDS011_PACKET_LEN bytes received
+     * @param PM25 : to store the measured PM2.5 value
+     * @param PM10 : to store the measured PM10 value
+     *
+     * @return :
+     *  SDS011_ERROR : not a valid data packet
+     *  SDS011_OK    : all good
+     */
+    int Decode_data(const uint8_t *packet, float *PM25, float *PM10);
+
   private:
     
     /**
@@ -31,6 +31,7 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <stdlib.h>
+#include <string.h>
 #include "sdsmon.h"
 
 /* indicate these serial calls are C-programs and not to be linked */
@@ -52,7 +53,7 @@ int sdsverbose = 0;
 /**
  * constructor
  **/
-SDSmon::SDSmon(void) {}
+SDSmon::SDSmon(void) {rcnt = 0;}
 
 /**
  *  @brief close program correctly
@@ -95,6 +96,76 @@ int SDSmon::read_sds(float *pm25, float *pm10)
     return(0);
 }
 
+/**
+ * @brief : return the file descriptor of the SDS
+ *
+ * @return  -1 if not connected
+ */
+int SDSmon::get_fd_sds()
+{
+    return(sdsconnected ? sdsfd : -1);
+}
+
+/**
+ * @brief request data, the response is handled by receive_sds()
+ *
+ * @return
+ * 0 success
+ * -1 error
+ */
+int SDSmon::query_sds()
+{
+    if (!sdsconnected) return(-1);
+
+    rcnt = 0;
+
+    if (Query_request() == SDS011_ERROR) {
+        printf("SDS monitor: error during query data\n");
+        return(-1);
+    }
+
+    return(0);
+}
+
+/**
+ * @brief read the bytes that are available (does not wait)
+ * @param pm25 : store value PM2.5
+ * @param pm10 : store value PM10
+ *
+ * @return
+ * 1 new values
+ * 0 response not complete yet
+ * -1 error
+ */
+int SDSmon::receive_sds(float *pm25, float *pm10)
+{
+    int len, i = 0;
+
+    if (!sdsconnected) return(-1);
+
+    len = read(sdsfd, &rbuf[rcnt], SDS011_PACKET_LEN - rcnt);
+    if (len <= 0) return(len == 0 ? 0 : -1);
+
+    // skip anything before the start of a packet
+    if (rcnt == 0) {
+        while (i < len && rbuf[i] != SDS011_BYTE_BEGIN) i++;
+        memmove(rbuf, &rbuf[i], len - i);
+        len -= i;
+    }
+
+    rcnt += len;
+    if (rcnt < SDS011_PACKET_LEN) return(0);
+
+    rcnt = 0;
+
+    if (Decode_data(rbuf, pm25, pm10) == SDS011_ERROR) {
+        printf("SDS monitor: error in received data\n");
+        return(-1);
+    }
+
+    return(1);
+}
+
 /** 
  * @brief open connection to SDS
  * @param device: the device to use to connect to SDS
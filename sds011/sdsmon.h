@@ -58,6 +58,37 @@ class SDSmon : public SDS
      * -1 error
      */
     int read_sds(float *pm25, float *pm10);
+
+    /**
+     * @brief : return the file descriptor of the SDS, to wait for
+     * data with poll() / epoll
+     *
+     * @return  -1 if not connected
+     */
+    int get_fd_sds();
+
+    /**
+     * @brief request data, the response is handled by receive_sds()
+     *
+     * @return
+     * 0 success
+     * -1 error
+     */
+    int query_sds();
+
+    /**
+     * @brief read the bytes that are available (does not wait)
+     * @param pm25 : return value PM2.5
+     * @param pm10 : return value PM10
+     *
+     * @return
+     * 1 new values
+     * 0 response not complete yet
+     * -1 error
+     */
+    int receive_sds(float *pm25, float *pm10);
    
    private:
+    uint8_t rbuf[SDS011_PACKET_LEN];    // response received so far
+    uint8_t rcnt;                       // bytes in rbuf
 };
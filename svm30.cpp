@@ -3,10 +3,14 @@
  * Resources / dependencies:
  * 
  * BCM2835 library (http://www.airspayce.com/mikem/bcm2835/)
+ * or the Linux i2c-dev interface (/dev/i2c-N)
  * 
  * To create a build with only the SVM30 monitor type: 
  *      make
  *
+ * To create a build using i2c-dev instead of BCM2835 (no root needed):
+ *      make I2C=dev
+ *
  *  To create a build with the SVM30 and SDS011 monitor type:
  *      make BUILD=SDS011 (requires the sds011 sub-directory)
  *
@@ -38,8 +42,15 @@
  **********************************************************************/
 
 # include "svm30lib.h"
+# include "svm30sim.h"
+# include "svm30capture.h"
+# include "svm30fault.h"
+# include "svm30mux.h"
 # include <getopt.h>
 # include <signal.h>
+# include <sys/epoll.h>
+# include <sys/timerfd.h>
+# include <sys/signalfd.h>
 # include <stdint.h>
 # include <stdarg.h>
 # include <time.h>
@@ -59,6 +70,7 @@ typedef struct sds
     bool    include;        // true = include in output
     float   value_pm25;     // measured value sds
     float   value_pm10;     // measured value sds
+    bool    received;       // values have been received
 } sds;
 
 #endif //SDS011
@@ -80,15 +92,32 @@ typedef struct svm_par
     bool raw;                   // display H2 and Ethanol
     bool humComp;               // perform humidity compensation
     bool AirQual;               // display CO2 and TVOC
+    bool Aggregate;             // display CO2 / TVOC statistics of the loop delay
     bool HumTemp;               // display humidity and temperature
     bool DispBaseline;          // display baseline info
+    uint16_t BaseRefresh;       // read the displayed baseline every # seconds
     bool DewPoint;              // display dewpoint
     bool AbsHum;                // display absolute humidity
     bool HeatInd;               // display heatindex
     bool tempCel;               // display temperature in Celcius
+    uint8_t I2C_bus;            // i2c-dev bus number
+    bool simulate;              // use simulated SVM30
+    bool polling;               // poll for result instead of fixed wait
+    bool pipelined;             // SHTC1 converts while SGP30 measures
+    bool attach;                // continue with a measuring SGP30
+    char *store;                // directory of the baseline store
+    char *capture;              // capture I2C transactions to file
+    char *replay;               // replay I2C transactions from file
+    bool fault;                 // inject I2C faults
+    struct fault_cfg faults;    // faults to inject
+    uint8_t mux_addr;           // TCA9548A address (0 = none)
+    uint8_t mux_channel;        // TCA9548A channel of SVM30
+    bool sched;                 // measure each signal at its own interval
+    struct svm_schedule schedule; // intervals (mS)
     
     /* to store the SVM30 values */
     struct svm_values v;
+    struct svm_aggregate agg;   // 1Hz CO2 / TVOC readings since last output
 
 #ifdef SDS011                    // SDS monitor option
     /* include SDS info */
@@ -99,9 +128,29 @@ typedef struct svm_par
 /* used as part of p_printf() */
 bool NoColor=false;
 
+/* number of good and failed samples */
+uint32_t SamplesOK = 0, SamplesPartial = 0, SamplesFailed = 0;
+
+/* acquisition timer statistics and measurements still busy at a tick */
+struct svm_sampler TickStats;
+uint32_t Overruns = 0;
+
 /* global constructor */ 
 SVM30 MySensor;
 
+/* simulated SVM30 (option -Y) */
+SVM30_sim MySim;
+
+/* I2C capture (option -r) and replay (option -P) */
+SVM30_capture MyCapture;
+SVM30_replay MyReplay;
+
+/* I2C fault injection (option -f) */
+SVM30_fault MyFault;
+
+/* TCA9548A multiplexer (option -x) */
+SVM30_mux MyMux;
+
 char progname[20];
 
 /*********************************************************************
@@ -149,7 +198,88 @@ void p_printf(int level, char *format, ...) {
     // release memory
     free(col);
 }
+
+/*********************************************************************
+*  @brief display the injected I2C faults (option -f)
+**********************************************************************/
+void disp_faults()
+{
+    struct fault_stats st;
+
+    MyFault.GetStats(&st);
+
+    if (st.transactions == 0) return;
+
+    printf("Injected faults in %u transactions: NACK %u, clock stretch %u, "
+           "short read %u, CRC %u, latency %u\n", st.transactions, st.nack,
+           st.clkt, st.shortread, st.crc, st.latency);
+}
  
+/*********************************************************************
+*  @brief display the samples and retries
+**********************************************************************/
+void disp_retries()
+{
+    struct svm_retry r;
+
+    MySensor.GetRetryStats(&r);
+
+    if (SamplesFailed == 0 && SamplesPartial == 0 && r.retries == 0) return;
+
+    printf("Samples: %u good, %u partial, %u failed. Retries %u (%u recovered), "
+           "failed commands %u, bus recoveries %u\n", SamplesOK, SamplesPartial, SamplesFailed,
+           r.retries, r.recovered, r.failures, r.bus_recovery);
+
+    if (r.absent > 0)
+        printf("SVM30 dropped off the bus %u times, resumed %u times\n", r.absent, r.resumed);
+}
+
+/*********************************************************************
+*  @brief display the multiplexer statistics (option -x)
+**********************************************************************/
+void disp_mux()
+{
+    struct mux_stats st;
+
+    MyMux.GetStats(&st);
+
+    if (st.switches == 0) return;
+
+    printf("Multiplexer: %u channel switches (%u failed), %u transactions without switch, "
+           "%llu uS switching\n", st.switches, st.failed, st.skipped,
+           (unsigned long long) st.switch_time);
+}
+
+/*********************************************************************
+*  @brief display the cross-process bus lock statistics
+**********************************************************************/
+void disp_buslock()
+{
+    struct bus_stats st;
+
+    MySensor.GetTransport()->GetBusStats(&st);
+
+    if (st.exchanges == 0) return;
+
+    printf("Bus lock: %u exchanges (%u taken), wait avg %.1f max %.1f mS, hold avg %.1f max %.1f mS\n",
+           st.exchanges, st.taken, (float) st.wait / st.exchanges / 1000, (float) st.wait_max / 1000,
+           (float) st.hold / st.exchanges / 1000, (float) st.hold_max / 1000);
+}
+
+/*********************************************************************
+*  @brief display the acquisition timer statistics
+**********************************************************************/
+void disp_sampler()
+{
+    struct svm_sampler *st = &TickStats;
+
+    if (st->ticks == 0) return;
+
+    printf("Timer: %u ticks, %u missed, %u overrun, wake-up delay avg %.3f max %.3f mS, period %.3f - %.3f mS\n",
+           st->ticks, st->missed, Overruns, (float) st->late_sum / st->ticks / 1000, (float) st->late_max / 1000,
+           (float) st->period_min / 1000, (float) st->period_max / 1000);
+}
+
 /*********************************************************************
 *  @brief close hardware and program correctly
 **********************************************************************/
@@ -158,6 +288,19 @@ void closeout()
    /* reset pins in Raspberry Pi */
    MySensor.close();
 
+   if (MyReplay.GetMismatch() > 0)
+        p_printf(RED, (char *) "%u transactions did not match the capture\n", MyReplay.GetMismatch());
+
+   disp_sampler();
+
+   disp_retries();
+
+   disp_mux();
+
+   disp_buslock();
+
+   disp_faults();
+
 #ifdef SDS011       // SDS011 monitor
     SDSm.close_sds();
 #endif
@@ -250,18 +393,36 @@ void init_variables(struct svm_par *svm)
     svm->raw = false;              // No display H2 and Ethanol
     svm->humComp = false;          // No perform humidity compensation
     svm->AirQual = true;           // display CO2 and TVOC
+    svm->Aggregate = false;        // no CO2 / TVOC statistics
     svm->HumTemp = true;           // display humidity and temperature
     svm->DispBaseline = false;     // No display baseline info
+    svm->BaseRefresh = 60;         // read the baseline every minute
     svm->DewPoint = false;         // No display Dew point
     svm->AbsHum = false ;          // No display absolute humidity
     svm->HeatInd = false;          // No display Heat index
     svm->tempCel = true;           // display temperature in celsius
+    svm->I2C_bus = I2C_DEFAULT_BUS; // /dev/i2c-1
+    svm->simulate = false;         // use SVM30 hardware
+    svm->polling = false;          // fixed wait after command
+    svm->pipelined = false;        // measure one device at a time
+    svm->attach = false;           // (re)start the SGP30
+    svm->store = NULL;             // no baseline store
+    svm->sched = false;            // measure all signals every loop
+    svm->capture = NULL;           // no I2C capture
+    svm->replay = NULL;            // no I2C replay
+    svm->fault = false;            // no I2C fault injection
+    svm->mux_addr = 0;             // no multiplexer
+    svm->mux_channel = 0;
+    memset(&svm->faults, 0, sizeof(struct fault_cfg));
+    svm->faults.seed = 1;
+    svm->faults.delay = 10000;     // 10mS latency
     
 #ifdef SDS011
     /* SDS values */
     svm->sds.include = false;
     svm->sds.value_pm25 = 0;
     svm->sds.value_pm10 = 0;
+    svm->sds.received = false;
 #endif
 }
 
@@ -276,12 +437,63 @@ void init_hw(struct svm_par *svm)
 
     /* sync temperature setting between lib and program */
     MySensor.SetTempCelsius(svm->tempCel); 
+
+    /* select I2C bus (i2c-dev only) */
+    MySensor.SetI2CBus(svm->I2C_bus);
+
+    /* no hardware needed */
+    if (svm->simulate) MySensor.SetTransport(&MySim);
+
+    /* replay a capture instead of hardware */
+    if (svm->replay) {
+        MyReplay.SetReplay(svm->replay);
+        MySensor.SetTransport(&MyReplay);
+    }
+
+    /* SVM30 on a channel of a TCA9548A */
+    if (svm->mux_addr) {
+        if (! MyMux.SetMux(svm->mux_addr, MySensor.GetTransport())) {
+            p_printf(RED, (char *) "Invalid multiplexer address 0x%02X\n", svm->mux_addr);
+            exit(EXIT_FAILURE);
+        }
+
+        if (svm->simulate) MySim.SetMux(svm->mux_addr);
+
+        MySensor.SetTransport(MyMux.Channel(svm->mux_channel));
+    }
+
+    /* inject faults on the transport selected so far */
+    if (svm->fault) {
+        MyFault.SetFault(&svm->faults, MySensor.GetTransport());
+        MySensor.SetTransport(&MyFault);
+    }
+
+    /* capture the transactions of the transport selected so far */
+    if (svm->capture) {
+        MyCapture.SetCapture(svm->capture, MySensor.GetTransport());
+        MySensor.SetTransport(&MyCapture);
+    }
+
+    /* poll for result instead of fixed wait */
+    MySensor.SetReadyPolling(svm->polling);
+    MySensor.SetPipelined(svm->pipelined);
+    MySensor.SetAttach(svm->attach);
+    MySensor.SetHumidityComp(svm->humComp);
+    MySensor.SetBaselineStore(svm->store);
     
     if (! MySensor.begin()) {
         p_printf(RED,(char *)"Error during setting I2C\n");
         exit(EXIT_FAILURE);
     }
 
+    if (svm->attach) {
+        if (MySensor.IsAttached()) p_printf(YELLOW, (char *) "Attached to the measuring SGP30, baseline kept\n");
+        else p_printf(YELLOW, (char *) "SGP30 was not measuring, started\n");
+    }
+
+    if (svm->store && MySensor.IsRestored())
+        p_printf(YELLOW, (char *) "Baseline restored from %s\n", svm->store);
+
 #ifdef SDS011  // SDS011 monitor
     if (svm->sds.include) {
     
@@ -299,8 +511,11 @@ void init_hw(struct svm_par *svm)
 
 #ifdef SDS011
 /**
- * @brief read and display SDS011 information
+ * @brief display SDS011 information
  * @param svm : stored values
+ *
+ * The values are received by the main loop, this does not wait for
+ * the SDS011.
  * 
  * @return
  * false : no display done
@@ -311,12 +526,8 @@ bool sds_output(struct svm_par *svm)
     /* if no SDS device specified */
     if ( ! svm->sds.include) return(false);
     
-    // read values from SDS
-    if (SDSm.read_sds(&svm->sds.value_pm25, &svm->sds.value_pm10) != 0)
-    {
-        p_printf(RED, (char*) "error during reading sds\n");
-        return(false);
-    }
+    // nothing received from SDS yet
+    if ( ! svm->sds.received) return(false);
 
     p_printf(GREEN, (char *)"SDS011\t\tPM2.5:\t%-4.4f\t\tPM10:\t\t%-4.4f\n",
     svm->sds.value_pm25, svm->sds.value_pm10 );
@@ -325,6 +536,18 @@ bool sds_output(struct svm_par *svm)
 }
 #endif // SDS011
 
+/*****************************************************************
+ * @brief : describe the quality of a field for the output
+ * @param q : quality (SVM_Q_*)
+ ****************************************************************/
+const char *quality(uint8_t q)
+{
+    if (q & SVM_Q_FAILED) return(q & SVM_Q_STALE ? "\t(stale)" : "\t(failed)");
+    if (q & SVM_Q_WARMUP) return("\t(warm-up)");
+    if (q & SVM_Q_RANGE) return("\t(out of range)");
+    return("");
+}
+
 /*****************************************************************
  * @brief : output the results
  * 
@@ -343,12 +566,23 @@ void do_output(struct svm_par *svm)
                
     // format output of the data
     if (svm->AirQual) {
-        p_printf(GREEN,(char *) "CO2 equivalent\t\t%-5d\t\tTVOC\t\t%-5d\n",svm->v.CO2eq, svm->v.TVOC);
+        p_printf(GREEN,(char *) "CO2 equivalent\t\t%-5d\t\tTVOC\t\t%-5d%s\n",svm->v.CO2eq, svm->v.TVOC,
+                 quality(svm->v.q_aq));
+        output = true;
+    }
+
+    // all 1Hz readings since the previous output
+    if (svm->Aggregate && svm->agg.count > 0) {
+        p_printf(GREEN,(char *) "CO2 eq %4u readings\tmin %-5d max %-5d mean %-7.1f median %-5d\n",
+                 svm->agg.count, svm->agg.CO2eq.min, svm->agg.CO2eq.max, svm->agg.CO2eq.mean, svm->agg.CO2eq.median);
+        p_printf(GREEN,(char *) "TVOC   %4u readings\tmin %-5d max %-5d mean %-7.1f median %-5d\n",
+                 svm->agg.count, svm->agg.TVOC.min, svm->agg.TVOC.max, svm->agg.TVOC.mean, svm->agg.TVOC.median);
         output = true;
     }
     
     if (svm->raw) {
-        p_printf(GREEN,(char *) "H2 signal\t\t0x%-4X\t\tEthanol signal\t0x%-4X\n","H2 signal",svm->v.H2_signal, svm->v.Ethanol_signal);
+        p_printf(GREEN,(char *) "H2 signal\t\t0x%-4X\t\tEthanol signal\t0x%-4X%s\n",svm->v.H2_signal, svm->v.Ethanol_signal,
+                 quality(svm->v.q_raw));
         output = true;
     }
     
@@ -357,8 +591,8 @@ void do_output(struct svm_par *svm)
     else  buf[0] = 'F';
         
     if(svm->HumTemp) {
-        p_printf(GREEN,(char *) "Humidity\t\t%-6.2f%%\t\tTemperature\t%-2.2f %c\n",
-        (float) svm->v.humidity / 1000, (float) svm->v.temperature / 1000, buf[0]); 
+        p_printf(GREEN,(char *) "Humidity\t\t%-6.2f%%\t\tTemperature\t%-2.2f %c%s\n",
+        (float) svm->v.humidity / 1000, (float) svm->v.temperature / 1000, buf[0], quality(svm->v.q_th)); 
         output = true;
     }
 
@@ -381,7 +615,7 @@ void do_output(struct svm_par *svm)
     }   
 
     if(svm->DispBaseline) {
-        if (MySensor.GetBaseLines(&baseline)) {
+        if (MySensor.GetCachedBaseLines(&baseline, svm->BaseRefresh)) {
             // will return 0x0 in the first 15 seconds after reset/start
             p_printf(GREEN,(char *) "TVOC baseline\t\t0x%-04X\t\tCO2 Baseline\t0x%-04X\n"
             ,baseline >> 16 , baseline & 0xffff);
@@ -403,34 +637,36 @@ void do_output(struct svm_par *svm)
  ****************************************************************/
 uint8_t disp_dev(struct svm_par *svm)
 {
-    uint16_t    id[3];
-    char        buf[2];
+    struct svm_caps caps;
     
     p_printf(YELLOW, (char *) "Driver info : %s\n", MySensor.GetDriverVersion());
     
-    /* get the ID number (check that communication works) */
-    if(! MySensor.GetId(SGP30,id)) {
-       p_printf (RED, (char *) "Error during getting SGP30 ID number\n");
+    /* read by begin() (check that communication works) */
+    MySensor.GetCaps(&caps);
+
+    if(! caps.sgp30) {
+       p_printf (RED, (char *) "Error during getting SGP30 ID number and feature set\n");
        return(ERR_PROTOCOL);
     }
     
-    p_printf(YELLOW, (char *) "SGP30 ID : 0x%04X %04X %04X\n", id[0], id[1],id[2]);
+    p_printf(YELLOW, (char *) "SGP30 ID : 0x%04X %04X %04X\n", caps.serial[0], caps.serial[1], caps.serial[2]);
  
-     /* get the ID number (check that communication works) */
-    if(! MySensor.GetId(SHTC1,id)) {
+    if(! caps.shtc1) {
        p_printf (RED, (char *) "Error during getting SHTC1 ID number\n");
        return(ERR_PROTOCOL);
     }
     
-    p_printf(YELLOW, (char *) "SHTC1 ID : 0x%04X\n", id[0] & 0x3f);
-       
-     /* get the ID number (check that communication works) */
-    if(! MySensor.GetFeatureSet(buf)) {
-       p_printf (RED, (char *) "Error during getting feature set\n");
-       return(ERR_PROTOCOL);
-    }
+    p_printf(YELLOW, (char *) "SHTC1 ID : 0x%04X\n", caps.shtc1_id & 0x3f);
     
-    p_printf(YELLOW, (char *) "SGP30 product ID : 0x%02X, feature set 0x%2X\n", buf[0] & 0x3f, buf[1]);
+    p_printf(YELLOW, (char *) "SGP30 product ID : 0x%02X, feature set 0x%2X\n", caps.feature_set >> 8 & 0x3f, caps.level);
+    p_printf(YELLOW, (char *) "SGP30 supports H2 / Ethanol signals : %s, inceptive baseline : %s\n",
+             caps.raw ? "yes" : "no", caps.inceptive ? "yes" : "no");
+
+    /* an SGP30 before feature set 0x20 can not measure the raw signals */
+    if (svm->raw && ! caps.raw) {
+        p_printf(RED, (char *) "H2 and Ethanol signals are not supported, removed\n");
+        svm->raw = false;
+    }
     
     return(ERR_OK);
 }
@@ -484,29 +720,153 @@ bool set_baseline(struct svm_par *svm)
 }
 
 /*****************************************************************
- * @brief : set humidity compensation
- * @param svm : pointer to SVM30 parameters
+ * @brief sampler period : greatest common divisor of the intervals
+ * @param s : intervals (mS)
  ****************************************************************/
-bool do_humidityComp(struct svm_par *svm)
+uint32_t sched_period(struct svm_schedule *s)
 {
-    // if NOT requested, return
-    if (! svm->humComp) return(true); 
-    
-    if (! MySensor.SetHumidity(svm->v.absolute_hum)) {
-        p_printf (RED, (char *) "Error during setting humidity compensation\n");
+    uint32_t iv[3] = {s->aq, s->raw, s->th}, p = 0, a, b, t;
+
+    for (int i = 0; i < 3; i++) {
+        if (iv[i] == 0) continue;
+
+        a = p;
+        b = iv[i];
+        while (a) { t = b % a; b = a; a = t; }
+        p = b;
+    }
+
+    return(p);
+}
+
+/* event sources of the main loop */
+#define EV_TICK     1           // acquisition timer
+#define EV_SIGNAL   2           // shutdown signal
+#define EV_SENSOR   3           // SVM30 measurement needs attention
+#define EV_SDS      4           // SDS011 data received
+#define EV_STORE    5           // baseline checkpoint timer
+
+/*****************************************************************
+ * @brief : add a descriptor to the main loop
+ * @param efd : epoll descriptor
+ * @param fd : descriptor to wait for
+ * @param source : EV_TICK, EV_SIGNAL, EV_SENSOR, EV_SDS or EV_STORE
+ *
+ * @return : true on success
+ ****************************************************************/
+bool add_source(int efd, int fd, uint32_t source)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = source;
+
+    if (fd < 0 || epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        p_printf(RED,(char *)"Can not add event source %d\n", source);
         return(false);
     }
-    
+
     return(true);
 }
+
+/*****************************************************************
+ * @brief : update the timer statistics
+ * @param deadline : deadline of this tick (uS)
+ * @param missed : deadlines that passed without a tick
+ ****************************************************************/
+void tick_stats(uint64_t deadline, uint64_t missed)
+{
+    static uint64_t prev = 0;
+    struct timespec ts;
+    uint64_t now, late;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+    TickStats.ticks++;
+    TickStats.missed += missed;
+
+    late = now > deadline ? now - deadline : 0;
+    TickStats.late_sum += late;
+    if (late > TickStats.late_max) TickStats.late_max = late;
+
+    if (prev > 0) {
+        if (TickStats.period_min == 0 || now - prev < TickStats.period_min)
+            TickStats.period_min = now - prev;
+        if (now - prev > TickStats.period_max)
+            TickStats.period_max = now - prev;
+    }
+    prev = now;
+}
+
+/*****************************************************************
+ * @brief : handle a finished measurement
+ * @param svm : pointer to SVM30 parameters
+ * @param due : fields that were due
+ * @param done : fields that were measured
+ * @param fields : fields that trigger an output
+ ****************************************************************/
+void do_result(struct svm_par *svm, uint8_t due, uint8_t done, uint8_t fields)
+{
+    static bool present = true;
+
+    /* the air quality in between the outputs is only aggregated */
+    if (! (due & fields)) return;
+
+    /* check for setting new baseline
+     * must done no earlier than 15 seconds after init
+     * The end of calibration is detected as the read
+     * baseline gives a value other than 0
+     * This is handled in set_baseline() and will reset
+     * the setBaseline flag. A failure is tried again next time. */
+    if(svm->setBaseline) set_baseline(svm);
+
+    MySensor.GetAggregate(&svm->agg);
+
+    /* the fields that failed (after retries) are marked in the output,
+     * a sample without any field is skipped */
+    if (done) {
+
+        if (! present) p_printf(GREEN,(char *)"SVM30 is back, measurement resumed\n");
+        present = true;
+
+        do_output(svm);
+
+        if ((done & due) == due) SamplesOK++;
+        else SamplesPartial++;
+    }
+    else  {
+        // SVM30 dropped off the bus, it is probed until it returns
+        if (! MySensor.IsPresent()) {
+            if (present) p_printf(RED,(char *)"SVM30 not responding, waiting for it to return\n");
+            present = false;
+        }
+        else
+            p_printf(RED,(char *)"failed get values from SVM30\n");
+
+        SamplesFailed++;
+    }
+}
+
 /*****************************************************************
  * @brief Here is the main of the program 
  * @param svm : pointer to SVM30 parameters
+ *
+ * One thread waits with epoll for the acquisition timer, the SVM30
+ * measurement, the SDS011 and the shutdown signals and handles each
+ * when it is ready. Nothing sleeps or blocks on a device in between.
  ****************************************************************/
 void main_loop(struct svm_par *svm)
 {
-    int     loop_set;
-    uint8_t  wait;
+    struct epoll_event events[5];
+    struct itimerspec its;
+    struct signalfd_siginfo si;
+    sigset_t mask;
+    uint64_t exp, deadline, period;
+    int     loop_set, efd, tfd, sfd, bfd = -1, n, i;
+    uint8_t fields, due, pending = 0, carry = 0, st;
+    bool    run = true, store = false;
    
     if (disp_dev(svm) != ERR_OK) return;
     
@@ -523,50 +883,157 @@ void main_loop(struct svm_par *svm)
         else
             p_printf(RED,(char *)"MeasureTest failed\\n");
     }
-       
+
+    /* measurements are started on a fixed 1Hz deadline (SGP30
+     * algorithm). Without -I temperature, humidity (and raw) are
+     * measured every loop delay and the output follows that. */
+    if (! svm->sched) {
+        svm->schedule.aq = 1000;
+        svm->schedule.th = svm->loop_delay * 1000;
+        svm->schedule.raw = svm->raw ? svm->loop_delay * 1000 : 0;
+        fields = SVM_TH | (svm->raw ? SVM_RAW : 0);
+    }
+    else
+        fields = SVM_AQ | SVM_RAW | SVM_TH;
+
+    MySensor.SetSchedule(&svm->schedule);
+    period = (uint64_t) sched_period(&svm->schedule) * 1000;
+
+    /* from now on the shutdown signals are read from sfd */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    /* acquisition deadlines : absolute, starting now */
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    clock_gettime(CLOCK_MONOTONIC, &its.it_value);
+    its.it_interval.tv_sec = period / 1000000;
+    its.it_interval.tv_nsec = (period % 1000000) * 1000;
+    deadline = (uint64_t) its.it_value.tv_sec * 1000000 + its.it_value.tv_nsec / 1000 - period;
+
+    efd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (efd < 0 || sfd < 0 || tfd < 0 || timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        p_printf(RED,(char *)"Can not create main loop: %s\n", strerror(errno));
+        run = false;
+    }
+    else if (! add_source(efd, tfd, EV_TICK) || ! add_source(efd, sfd, EV_SIGNAL) ||
+             ! add_source(efd, MySensor.ReadyFd(), EV_SENSOR))
+        run = false;
+
+#ifdef SDS011
+    if (run && svm->sds.include && ! add_source(efd, SDSm.get_fd_sds(), EV_SDS)) run = false;
+#endif
+
+    /* the baseline is stored on its own timer, in between measurements */
+    if (run && svm->store) {
+        bfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = its.it_interval.tv_sec = BASE_INTERVAL;
+
+        if (bfd < 0 || timerfd_settime(bfd, 0, &its, NULL) < 0 || ! add_source(efd, bfd, EV_STORE))
+            run = false;
+    }
+
     /*  check for endless loop */
     if (svm->loop_count > 0 ) loop_set = svm->loop_count;
     else loop_set = 1;
     
     /* loop requested */
-    while (loop_set > 0)  {
-        
-    /* check for setting new baseline 
-     * must done no earlier than 15 seconds after init
-     * The end of calibration is detected as the read
-     * baseline gives a value other than 0
-     * This is handled in set_baseline() and will reset
-     * the setBaseline flag */
-        if(svm->setBaseline) {
-            if (!set_baseline(svm)) return;
-        }
-        
-        if (MySensor.GetValues(&svm->v,svm->raw)) {
-            do_output(svm);
-        }
-        else  {
-            p_printf(RED,(char *)"failed get values from SVM30\n");         
-            return;
+    while (run && loop_set > 0)  {
+
+        n = epoll_wait(efd, events, 5, -1);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            p_printf(RED,(char *)"Error in main loop: %s\n", strerror(errno));
+            break;
         }
-        
-        // check and do humidity compensation
-        if (! do_humidityComp(svm)) return;
-
-        /* delay for seconds */
-        wait = svm->loop_delay;
-        while (wait--) {
-            sleep(1);       // sleep 1 second
-            if( !MySensor.TriggerSGP30()) {
-                p_printf(RED,(char *)"Error during loop delay\n");
-                return;
+
+        for (i = 0; i < n && run && loop_set > 0; i++) {
+
+            switch(events[i].data.u32) {
+
+            case EV_SIGNAL:
+                if (read(sfd, &si, sizeof(si)) != sizeof(si)) break;
+                printf("\nStopping SVM30 monitor\n");
+                run = false;
+                break;
+
+            case EV_TICK:
+                if (read(tfd, &exp, sizeof(exp)) != sizeof(exp)) break;
+
+                // more than one expiration : deadlines were missed
+                deadline += exp * period;
+                tick_stats(deadline, exp - 1);
+
+                // signals that were due while the previous measurement ran
+                due = MySensor.GetDue(deadline / 1000) | carry;
+                if (due == 0) break;
+
+                // the previous measurement has not finished yet : keep the
+                // signals for the first tick after it has
+                if (pending) {
+                    if (due & ~carry) Overruns++;
+                    carry = due;
+                    break;
+                }
+
+                carry = 0;
+
+#ifdef SDS011
+                // PM values for the next output
+                if ((due & SVM_TH) && svm->sds.include) SDSm.query_sds();
+#endif
+                if (MySensor.StartMeasurement(due)) pending = due;
+                else {
+                    do_result(svm, due, 0, fields);
+                    if ((due & fields) && svm->loop_count > 0) loop_set--;
+                }
+                break;
+
+            case EV_SENSOR:
+                st = MySensor.Poll();
+                if (st != ASYNC_DONE && st != ASYNC_FAILED) break;
+
+                due = pending;
+                pending = 0;
+
+                do_result(svm, due, MySensor.GetResult(&svm->v), fields);
+                if ((due & fields) && svm->loop_count > 0) loop_set--;
+
+                // a checkpoint that came during the measurement
+                if (store) MySensor.Checkpoint();
+                store = false;
+                break;
+
+            case EV_STORE:
+                if (read(bfd, &exp, sizeof(exp)) != sizeof(exp)) break;
+
+                if (pending) store = true;
+                else MySensor.Checkpoint();
+                break;
+
+#ifdef SDS011
+            case EV_SDS:
+                if (SDSm.receive_sds(&svm->sds.value_pm25, &svm->sds.value_pm10) > 0)
+                    svm->sds.received = true;
+                break;
+#endif
             }
-        } 
-        
-        /* check for endless loop */
-        if (svm->loop_count > 0) loop_set--;
+        }
     }
-    
-    printf("Reached the loopcount of %d.\nclosing down\n", svm->loop_count);
+
+    if (efd >= 0) close(efd);
+    if (tfd >= 0) close(tfd);
+    if (sfd >= 0) close(sfd);
+    if (bfd >= 0) close(bfd);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    if (loop_set == 0) printf("Reached the loopcount of %d.\nclosing down\n", svm->loop_count);
 }       
 
 /*********************************************************************
@@ -585,19 +1052,37 @@ void usage(struct svm_par *svm)
     "-t 0x# set baseline TVOC to ####\n"
     "-h     continued humidity compensation          (default %s)\n"
     "-m     perform a measurement test               (default %s)\n"
+    "-q     poll for results instead of fixed wait   (default %s)\n"
+    "-p     measure SGP30 and SHTC1 at the same time (default %s)\n"
+    "-a     attach to a measuring SGP30, no restart  (default %s)\n"
+    "-k dir store the baseline every hour in dir and restore it at start\n"
     
     "\nprogram control settings\n"
     "-d     display ID-numbers and feature set only\n"
     "-l #   number of measurements (0 = endless)     (default %d)\n"
     "-w #   wait-time (seconds) between measurements (default %d)\n"
+    "-I a:t[:r] measure CO2/TVOC every a, temperature / humidity every t\n"
+    "       and H2 / Ethanol every r seconds (ignores -w)\n"
     "-v     include verbose / debug information      (default %s)\n"
+#ifdef I2CDEV
+    "-b #   I2C bus to use (/dev/i2c-#)              (default %d)\n"
+#endif
+    "-Y     use simulated SVM30 (no hardware)        (default %s)\n"
+    "-r file capture all I2C transactions to file\n"
+    "-P file replay I2C transactions from file (no hardware)\n"
+    "-x a:c  SVM30 on channel c of TCA9548A at address a (0x71 - 0x77)\n"
+    "-f spec inject I2C faults, spec is a comma separated list of\n"
+    "        nack=#,clkt=#,short=#,crc=#,lat=# (chance per 1000),\n"
+    "        delay=# (latency uS) and seed=#\n"
     
     "\noutput formatting\n"
     "-D     do not display output in color           (default %s)\n"
     "-T     add / remove timestamp                   (default %s)\n"
     "-H     add / remove humidity & temperature      (default %s)\n"
     "-A     add / remove CO2 / TVOC info             (default %s)\n"
+    "-M     add / remove CO2 / TVOC min/max/mean/median (default %s)\n"
     "-B     add / remove baseline info               (default %s)\n"
+    "-u #   read the baseline info every # seconds   (default %d)\n"
     "-R     add / remove H2 and Ethanol signals      (default %s)\n"
     "-E     add / remove Dew point calculation       (default %s)\n"
     "-J     add / remove Absolute Humidity calc      (default %s)\n"
@@ -611,13 +1096,22 @@ void usage(struct svm_par *svm)
    , progname, version, 
    svm->humComp?"enabled":"disabled",
    svm->measure?"enabled":"disabled",
+   svm->polling?"enabled":"disabled",
+   svm->pipelined?"enabled":"disabled",
+   svm->attach?"enabled":"disabled",
    svm->loop_count, svm->loop_delay, 
    svm->verbose?"added":"removed",
+#ifdef I2CDEV
+   svm->I2C_bus,
+#endif
+   svm->simulate?"simulated":"hardware",
    NoColor?"No color":"color",
    svm->timestamp?"added":"removed",  
    svm->HumTemp?"added":"removed", 
    svm->AirQual?"added":"removed",
+   svm->Aggregate?"added":"removed",
    svm->DispBaseline?"added":"removed",
+   svm->BaseRefresh,
    svm->raw?"added":"removed",
    svm->DewPoint?"added":"removed",
    svm->AbsHum?"added":"removed",
@@ -625,6 +1119,36 @@ void usage(struct svm_par *svm)
    svm->tempCel?"Celcius":"Fahrenheit");
 }
 
+/*********************************************************************
+ * Parse fault injection specification
+ * @param spec : comma separated list of name=value
+ * @param cfg : store fault settings
+ *
+ * @return : true if valid, else false
+ *********************************************************************/
+bool parse_faults(char *spec, struct fault_cfg *cfg)
+{
+    char    *p, name[10];
+    unsigned int val;
+
+    for (p = strtok(spec, ","); p != NULL; p = strtok(NULL, ",")) {
+
+        if (sscanf(p, "%9[^=]=%u", name, &val) != 2) return(false);
+
+        if (strcmp(name, "seed") == 0) cfg->seed = val;
+        else if (strcmp(name, "delay") == 0) cfg->delay = val;
+        else if (val > 1000) return(false);
+        else if (strcmp(name, "nack") == 0) cfg->nack = val;
+        else if (strcmp(name, "clkt") == 0) cfg->clkt = val;
+        else if (strcmp(name, "short") == 0) cfg->shortread = val;
+        else if (strcmp(name, "crc") == 0) cfg->crc = val;
+        else if (strcmp(name, "lat") == 0) cfg->latency = val;
+        else return(false);
+    }
+
+    return(true);
+}
+
 /*********************************************************************
  * Parse parameter input 
  * @param svm : pointer to SVM30 parameters
@@ -662,6 +1186,22 @@ void parse_cmdline(int opt, char *option, struct svm_par *svm)
         }
         break;
  
+    case 'q':   // poll for results
+        svm->polling = true;
+        break;
+
+    case 'p':   // overlap SHTC1 and SGP30 measurements
+        svm->pipelined = true;
+        break;
+
+    case 'a':   // keep the IAQ algorithm of a measuring SGP30
+        svm->attach = true;
+        break;
+
+    case 'k':   // baseline store
+        svm->store = option;
+        break;
+
     case 'h':   // SVM30 continued humidity compensation 
         svm->humComp = true;
         break;
@@ -674,6 +1214,10 @@ void parse_cmdline(int opt, char *option, struct svm_par *svm)
         svm->AirQual = ! svm->AirQual;
         break;
 
+    case 'M':   // toggle add / remove CO2 / TVOC statistics
+        svm->Aggregate = ! svm->Aggregate;
+        break;
+
     case 'E':   // toggle add / remove dewpoint
         svm->DewPoint = ! svm->DewPoint;
         break;
@@ -713,6 +1257,10 @@ void parse_cmdline(int opt, char *option, struct svm_par *svm)
         } 
         break;
           
+    case 'u':   // baseline info refresh
+        svm->BaseRefresh = (uint16_t) strtod(option, NULL);
+        break;
+
     case 'w':   // loop delay in between measurements
         svm->loop_delay = (uint16_t) strtod(option, NULL);
         if (svm->loop_delay == 0 ) {
@@ -732,6 +1280,78 @@ void parse_cmdline(int opt, char *option, struct svm_par *svm)
 
         break;
       
+    case 'b':   // I2C bus
+#ifdef I2CDEV
+        svm->I2C_bus = (uint8_t) strtod(option, NULL);
+#else
+        p_printf(RED, (char *) "I2C bus selection is not supported in this build\n");
+#endif
+        break;
+
+    case 'Y':   // use simulated SVM30
+        svm->simulate = true;
+        break;
+
+    case 'r':   // capture I2C transactions
+        svm->capture = option;
+        break;
+
+    case 'P':   // replay I2C transactions
+        svm->replay = option;
+        break;
+
+    case 'x':   // TCA9548A address and channel
+    {
+        char *p;
+
+        svm->mux_addr = (uint8_t) strtol(option, &p, 0);
+        if (*p != ':' || svm->mux_addr < MUX_ADDR_MIN || svm->mux_addr > MUX_ADDR_MAX) {
+            p_printf(RED, (char *) "Incorrect multiplexer address. Must be between 0x%02X and 0x%02X\n",
+                     MUX_ADDR_MIN, MUX_ADDR_MAX);
+            exit(EXIT_FAILURE);
+        }
+
+        svm->mux_channel = (uint8_t) strtol(p + 1, NULL, 0);
+        if (svm->mux_channel >= MUX_CHANNELS) {
+            p_printf(RED, (char *) "Incorrect multiplexer channel. Must be between 0 and %d\n",
+                     MUX_CHANNELS - 1);
+            exit(EXIT_FAILURE);
+        }
+        break;
+    }
+
+    case 'I':   // interval per signal
+    {
+        char *p;
+
+        memset(&svm->schedule, 0, sizeof(svm->schedule));
+        svm->schedule.aq = (uint32_t) (strtod(option, &p) * 1000);
+
+        if (*p == ':') svm->schedule.th = (uint32_t) (strtod(p + 1, &p) * 1000);
+        else p = (char *) "x";
+
+        if (*p == ':') {
+            svm->schedule.raw = (uint32_t) (strtod(p + 1, &p) * 1000);
+            svm->raw = true;
+        }
+
+        if (*p != 0x0 || (svm->schedule.aq == 0 && svm->schedule.th == 0)) {
+            p_printf(RED, (char *) "Incorrect intervals %s. Must be a:t or a:t:r (seconds)\n", option);
+            exit(EXIT_FAILURE);
+        }
+
+        svm->sched = true;
+        break;
+    }
+
+    case 'f':   // inject I2C faults
+        if (! parse_faults(option, &svm->faults)) {
+            p_printf(RED, (char *) "Incorrect fault specification %s\n", option);
+            exit(EXIT_FAILURE);
+        }
+        svm->fault = true;
+        break;
+
     case 'S':   // include SDS011 read
 #ifdef SDS011        
         strncpy(svm->sds.port, option, MAXBUF);
@@ -755,11 +1375,6 @@ int main(int argc, char *argv[])
     int opt;
     struct svm_par svm; // parameters
 
-    if (geteuid() != 0)  {
-        p_printf(RED,(char *) "You must be super user\n");
-        exit(EXIT_FAILURE);
-    }
-    
     /* set signals */
     set_signals(); 
  
@@ -770,10 +1385,17 @@ int main(int argc, char *argv[])
     init_variables(&svm);
 
     /* parse commandline */
-    while ((opt = getopt(argc, argv, "c:t:hmdl:w:vDEFJTAGHBRP:S:")) != -1) {
+    while ((opt = getopt(argc, argv, "c:t:hmqpak:dl:w:u:vb:Yr:f:x:I:MDEFJTAGHBRP:S:")) != -1) {
         parse_cmdline(opt, optarg, &svm);
     }
 
+#ifndef I2CDEV      // BCM2835 needs access to /dev/mem
+    if (geteuid() != 0 && ! svm.simulate && ! svm.replay)  {
+        p_printf(RED,(char *) "You must be super user\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
     /* initialise hardware */
     init_hw(&svm);
 
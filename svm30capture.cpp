@@ -0,0 +1,342 @@
+/**
+ * SVM30 I2C capture and replay
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *********************************************************************
+ */
+
+# include "svm30capture.h"
+# include "svm30lib.h"
+# include <time.h>
+
+/**
+ * @brief : get monotonic time in uS
+ */
+static uint64_t cap_time() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/*****************************************************************
+ * capture
+ ****************************************************************/
+
+/**
+ * @brief constructor and initialize variables
+ */
+SVM30_capture::SVM30_capture(void) {
+    _File = NULL;
+    _fp = NULL;
+    _I2C = NULL;
+    _Last = 0;
+}
+
+/**
+ * @brief : set the capture file and the transport to capture
+ *
+ * @param file : file to write
+ * @param transport : transport that performs the transactions
+ */
+void SVM30_capture::SetCapture(const char *file, SVM30_I2C *transport) {
+    _File = file;
+    _I2C = transport;
+}
+
+/**
+ * @brief : open capture file and captured transport
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30_capture::Open() {
+
+    if (_File == NULL || _I2C == NULL) return(false);
+
+    _fp = fopen(_File, "wb");
+
+    if (_fp == NULL) {
+        printf("Can't create capture file %s\n", _File);
+        return(false);
+    }
+
+    fwrite(CAP_MAGIC, 1, strlen(CAP_MAGIC), _fp);
+    fputc(CAP_VERSION, _fp);
+
+    _Last = cap_time();
+
+    _I2C->EnableDebugging(_I2C_Debug);
+
+    if (! _I2C->Open()) {
+        Close();
+        return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief : close captured transport and capture file
+ */
+void SVM30_capture::Close() {
+
+    if (_I2C != NULL) _I2C->Close();
+
+    if (_fp != NULL) {
+        fclose(_fp);
+        _fp = NULL;
+    }
+}
+
+/**
+ * @brief : write record to capture file
+ * @param r : record to write
+ *
+ * Each record is flushed, so a capture is complete up to the moment a
+ * unit stops.
+ */
+void SVM30_capture::Record(struct cap_record *r) {
+    uint64_t now = cap_time();
+    uint8_t  hdr[CAP_RECORD];
+    uint32_t delta = now - _Last;
+
+    if (_fp == NULL) return;
+
+    _Last = now;
+
+    hdr[0] = delta & 0xff;
+    hdr[1] = delta >> 8 & 0xff;
+    hdr[2] = delta >> 16 & 0xff;
+    hdr[3] = delta >> 24 & 0xff;
+    hdr[4] = r->type;
+    hdr[5] = r->address;
+    hdr[6] = r->result;
+    hdr[7] = r->wlen;
+    hdr[8] = r->rlen;
+
+    fwrite(hdr, 1, CAP_RECORD, _fp);
+    fwrite(r->wbuf, 1, r->wlen, _fp);
+    fwrite(r->rbuf, 1, r->rlen, _fp);
+    fflush(_fp);
+}
+
+/**
+ * @brief : write to device and capture
+ */
+uint8_t SVM30_capture::Write(uint8_t address, uint8_t *buf, uint8_t len) {
+    struct cap_record r;
+
+    r.result = _I2C->Write(address, buf, len);
+    r.type = CAP_WRITE;
+    r.address = address;
+    r.wlen = len;
+    r.rlen = 0;
+    memcpy(r.wbuf, buf, len);
+
+    Record(&r);
+
+    return(r.result);
+}
+
+/**
+ * @brief : read from device and capture
+ */
+uint8_t SVM30_capture::Read(uint8_t address, uint8_t *buf, uint8_t len) {
+    struct cap_record r;
+
+    r.result = _I2C->Read(address, buf, len);
+    r.type = CAP_READ;
+    r.address = address;
+    r.wlen = 0;
+    r.rlen = len;
+    memcpy(r.rbuf, buf, len);
+
+    Record(&r);
+
+    return(r.result);
+}
+
+/**
+ * @brief : write and read in one transaction and capture
+ */
+uint8_t SVM30_capture::Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen) {
+    struct cap_record r;
+
+    r.result = _I2C->Transfer(address, wbuf, wlen, rbuf, rlen);
+    r.type = CAP_TRANSFER;
+    r.address = address;
+    r.wlen = wlen;
+    r.rlen = rlen;
+    memcpy(r.wbuf, wbuf, wlen);
+    memcpy(r.rbuf, rbuf, rlen);
+
+    Record(&r);
+
+    return(r.result);
+}
+
+/*****************************************************************
+ * replay
+ ****************************************************************/
+
+/**
+ * @brief constructor and initialize variables
+ */
+SVM30_replay::SVM30_replay(void) {
+    _File = NULL;
+    _fp = NULL;
+    _Mismatch = 0;
+}
+
+/**
+ * @brief : open the capture file to replay
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30_replay::Open() {
+    char hdr[CAP_HEADER];
+
+    if (_File == NULL) return(false);
+
+    _fp = fopen(_File, "rb");
+
+    if (_fp == NULL) {
+        printf("Can't open capture file %s\n", _File);
+        return(false);
+    }
+
+    if (fread(hdr, 1, CAP_HEADER, _fp) != CAP_HEADER ||
+        memcmp(hdr, CAP_MAGIC, strlen(CAP_MAGIC)) != 0 ||
+        hdr[CAP_HEADER - 1] != CAP_VERSION) {
+
+        printf("%s is not a valid capture file\n", _File);
+        Close();
+        return(false);
+    }
+
+    _Mismatch = 0;
+
+    return(true);
+}
+
+/**
+ * @brief : close the capture file
+ */
+void SVM30_replay::Close() {
+
+    if (_fp != NULL) {
+        fclose(_fp);
+        _fp = NULL;
+    }
+}
+
+/**
+ * @brief : read the next record and compare with the transaction
+ * the driver performs.
+ *
+ * @param r : store record
+ * @param type / address / wbuf / wlen / rlen : transaction of driver
+ *
+ * @return :
+ *  true if the record matches, else false
+ */
+bool SVM30_replay::Next(struct cap_record *r, uint8_t type, uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t rlen) {
+    uint8_t hdr[CAP_RECORD];
+
+    if (_fp == NULL) return(false);
+
+    if (fread(hdr, 1, CAP_RECORD, _fp) != CAP_RECORD) {
+        if (_I2C_Debug) printf("End of capture file\n");
+        return(false);
+    }
+
+    r->time = hdr[0] | hdr[1] << 8 | hdr[2] << 16 | (uint32_t) hdr[3] << 24;
+    r->type = hdr[4];
+    r->address = hdr[5];
+    r->result = hdr[6];
+    r->wlen = hdr[7];
+    r->rlen = hdr[8];
+
+    if (fread(r->wbuf, 1, r->wlen, _fp) != r->wlen ||
+        fread(r->rbuf, 1, r->rlen, _fp) != r->rlen) {
+        if (_I2C_Debug) printf("Truncated capture file\n");
+        return(false);
+    }
+
+    if (r->type != type || r->address != address || r->wlen != wlen ||
+        r->rlen != rlen || memcmp(r->wbuf, wbuf, wlen) != 0) {
+
+        if (_I2C_Debug) printf("Replay mismatch : captured '%c' to 0x%02X\n", r->type, r->address);
+        _Mismatch++;
+        return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief : replay a write
+ *
+ * @return : captured result or ERR_PROTOCOL if not matching
+ */
+uint8_t SVM30_replay::Write(uint8_t address, uint8_t *buf, uint8_t len) {
+    struct cap_record r;
+
+    if (! Next(&r, CAP_WRITE, address, buf, len, 0)) return(ERR_PROTOCOL);
+
+    return(r.result);
+}
+
+/**
+ * @brief : replay a read
+ *
+ * @return : captured result or ERR_PROTOCOL if not matching
+ */
+uint8_t SVM30_replay::Read(uint8_t address, uint8_t *buf, uint8_t len) {
+    struct cap_record r;
+
+    if (! Next(&r, CAP_READ, address, NULL, 0, len)) return(ERR_PROTOCOL);
+
+    memcpy(buf, r.rbuf, len);
+
+    return(r.result);
+}
+
+/**
+ * @brief : replay a write and read in one transaction
+ *
+ * @return : captured result or ERR_PROTOCOL if not matching
+ */
+uint8_t SVM30_replay::Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen) {
+    struct cap_record r;
+
+    if (! Next(&r, CAP_TRANSFER, address, wbuf, wlen, rlen)) return(ERR_PROTOCOL);
+
+    memcpy(rbuf, r.rbuf, rlen);
+
+    return(r.result);
+}
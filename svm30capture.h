@@ -0,0 +1,151 @@
+/**
+ * SVM30 I2C capture and replay Header file
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * SVM30_capture sits in between the driver and another transport and
+ * writes every bus transaction to a file. SVM30_replay reads that file
+ * and feeds the recorded results back to the driver, at full speed and
+ * without hardware. The driver must use the same settings (e.g. -q) as
+ * during the capture, else the transactions will not match.
+ *
+ * File format (all numbers little endian) :
+ *  header : "SVM30CAP" + version (1 byte)
+ *  record : time   (4 bytes) uS since previous record
+ *           type   (1 byte)  'W' write, 'R' read, 'T' write + read
+ *           address(1 byte)  I2C address
+ *           result (1 byte)  ERR_OK or error code
+ *           wlen   (1 byte)  bytes written
+ *           rlen   (1 byte)  bytes read
+ *           wlen bytes written, rlen bytes read
+ *********************************************************************
+ */
+#ifndef SVM30_CAPTURE_H
+#define SVM30_CAPTURE_H
+
+# include "svm30i2c.h"
+
+#define CAP_MAGIC       "SVM30CAP"
+#define CAP_VERSION     1
+#define CAP_HEADER      9           // magic + version
+#define CAP_RECORD      9           // record without data bytes
+
+#define CAP_WRITE       'W'
+#define CAP_READ        'R'
+#define CAP_TRANSFER    'T'
+
+/* one captured transaction */
+struct cap_record
+{
+    uint32_t time;                  // uS since previous record
+    uint8_t  type;                  // CAP_WRITE, CAP_READ or CAP_TRANSFER
+    uint8_t  address;               // I2C address
+    uint8_t  result;                // result code
+    uint8_t  wlen;                  // bytes written
+    uint8_t  rlen;                  // bytes read
+    uint8_t  wbuf[255];
+    uint8_t  rbuf[255];
+};
+
+class SVM30_capture : public SVM30_I2C
+{
+  public:
+
+    SVM30_capture(void);
+
+    /**
+     * @brief set the capture file and the transport to capture
+     *
+     * @param file : file to write
+     * @param transport : transport that performs the transactions
+     *
+     * Must be called before Open().
+     */
+    void SetCapture(const char *file, SVM30_I2C *transport);
+
+    bool Open();
+    void Close();
+    uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen);
+    void Delay(useconds_t us) {_I2C->Delay(us);}
+    void Elapsed(useconds_t us) {_I2C->Elapsed(us);}
+    bool Recover() {return(_I2C->Recover());}
+    void Lock() {_I2C->Lock();}
+    void Unlock() {_I2C->Unlock();}
+    void BusLock() {_I2C->BusLock();}
+    void BusUnlock() {_I2C->BusUnlock();}
+    void DeviceLock() {_I2C->DeviceLock();}
+    void DeviceUnlock() {_I2C->DeviceUnlock();}
+    void GetBusStats(struct bus_stats *st) {_I2C->GetBusStats(st);}
+    uint32_t BusTaken() {return(_I2C->BusTaken());}
+
+  private:
+    const char *_File;
+    FILE    *_fp;
+    SVM30_I2C *_I2C;                // captured transport
+    uint64_t _Last;                 // time of previous record (uS)
+
+    void Record(struct cap_record *r);
+};
+
+class SVM30_replay : public SVM30_I2C
+{
+  public:
+
+    SVM30_replay(void);
+
+    /**
+     * @brief set the file to replay. Must be called before Open().
+     */
+    void SetReplay(const char *file) {_File = file;}
+
+    /**
+     * @brief : number of transactions that did not match the capture
+     */
+    uint32_t GetMismatch() {return(_Mismatch);}
+
+    /**
+     * @brief : true if all records have been replayed
+     */
+    bool Finished() {return(_fp == NULL || feof(_fp));}
+
+    bool Open();
+    void Close();
+    uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen);
+    void Delay(useconds_t us) {}
+    bool Recover() {return(true);}
+
+  private:
+    const char *_File;
+    FILE    *_fp;
+    uint32_t _Mismatch;             // transactions not as captured
+
+    bool Next(struct cap_record *r, uint8_t type, uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t rlen);
+};
+
+#endif /* SVM30_CAPTURE_H */
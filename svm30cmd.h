@@ -0,0 +1,84 @@
+/**
+ * SVM30 command descriptor Header file
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * One compile-time descriptor for every SGP30 / SHTC1 command. The
+ * descriptor is the single place that defines the framing (parameter
+ * and response words), the timing and the minimum SGP30 feature set
+ * level of a command. The driver helpers SVM30::Command<>() and
+ * SVM30::Request<>() take a descriptor as template argument, so a
+ * wrong number of parameter or response words will not compile.
+ *
+ * source timing : datasheet SGP30 (table 10) and SHTC1 (table 4)
+ *
+ * wait : the time the driver waits after sending the command when
+ * readiness polling is not enabled. The Raspberry Pi needs MUCH longer
+ * than the datasheet timing (see version 1.2 of svm30lib.cpp).
+ *
+ * retry : the number of times the driver repeats a failed command. All
+ * commands can be repeated without harm, Measure_Test only once as it
+ * takes 220mS. The general call reset is not acknowledged by every
+ * device, a failure is normal and not repeated.
+ *********************************************************************
+ */
+#ifndef SVM30_CMD_H
+#define SVM30_CMD_H
+
+# include <stdint.h>
+
+struct svm30_cmd
+{
+    uint8_t  address;       // I2C address of device
+    uint16_t cmd;           // command word
+    uint8_t  param;         // number of parameter words (each + CRC)
+    uint8_t  resp;          // number of response words (each + CRC)
+    uint32_t typ;           // typical duration (uS)
+    uint32_t max;           // maximum duration (uS)
+    uint32_t wait;          // fixed wait after sending (uS)
+    uint8_t  level;         // minimum SGP30 feature set level (0 = any)
+    uint8_t  retry;         // retries after a failure
+};
+
+/*                                                      address        command                            param resp typ     max     wait    level retry */
+constexpr svm30_cmd CMD_General_Call_Reset            = {RESET_ADDRESS, RESET_CMD,                          0, 0,      0,      0,  50000,    0,     0};
+
+constexpr svm30_cmd CMD_SGP30_Init_Air_Quality        = {SGP30_ADDRESS, SGP30_Init_Air_Quality,             0, 0,   2000,  10000,  50000,    0,     2};
+constexpr svm30_cmd CMD_SGP30_Measure_Air_Quality     = {SGP30_ADDRESS, SGP30_Measure_Air_Quality,          0, 2,  10000,  12000,  50000,    0,     2};
+constexpr svm30_cmd CMD_SGP30_Get_Baseline            = {SGP30_ADDRESS, SGP30_Get_Baseline,                 0, 2,  10000,  10000,  50000,    0,     2};
+constexpr svm30_cmd CMD_SGP30_Set_Baseline            = {SGP30_ADDRESS, SGP30_Set_Baseline,                 2, 0,  10000,  10000,  50000,    0,     2};
+constexpr svm30_cmd CMD_SGP30_Set_Humidity            = {SGP30_ADDRESS, SGP30_Set_Humidity,                 1, 0,   1000,  10000,  50000,    0,     2};
+constexpr svm30_cmd CMD_SGP30_Measure_Test            = {SGP30_ADDRESS, SGP30_Measure_Test,                 0, 1, 200000, 220000, 500000,    0,     1};
+constexpr svm30_cmd CMD_SGP30_Get_Feature_Set         = {SGP30_ADDRESS, SGP30_Get_Feature_Set,              0, 1,   1000,   2000,  50000,    0,     2};
+constexpr svm30_cmd CMD_SGP30_Measure_Raw_Signals     = {SGP30_ADDRESS, SGP30_Measure_Raw_Signals,          0, 2,  20000,  25000, 250000, 0x20, 2};
+constexpr svm30_cmd CMD_SGP30_Get_Inceptive_Baseline  = {SGP30_ADDRESS, SGP30_Get_tvoc_inceptive_baseline,  0, 1,  10000,  10000,  50000, 0x22,     2};
+constexpr svm30_cmd CMD_SGP30_Set_Inceptive_Baseline  = {SGP30_ADDRESS, SGP30_Set_tvoc_inceptive_baseline,  1, 0,  10000,  10000,  50000, 0x22,     2};
+constexpr svm30_cmd CMD_SGP30_Read_ID                 = {SGP30_ADDRESS, SGP30_Read_ID,                      0, 3,    500,    500,  50000,    0,     2};
+
+constexpr svm30_cmd CMD_SHTC1_Read_Temp_First         = {SHTC1_ADDRESS, SHTC1_Read_Temp_First,              0, 2,  10800,  14400,  50000,    0,     2};
+constexpr svm30_cmd CMD_SHTC1_Read_ID                 = {SHTC1_ADDRESS, SHTC1_Read_ID,                      0, 1,      0,      0,      0,    0,     2};
+constexpr svm30_cmd CMD_SHTC1_Reset                   = {SHTC1_ADDRESS, SHTC1_Reset,                        0, 0,    240,    240,  50000,    0,     2};
+
+#endif /* SVM30_CMD_H */
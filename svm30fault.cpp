@@ -0,0 +1,190 @@
+/**
+ * SVM30 I2C fault injection
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *********************************************************************
+ */
+
+# include "svm30fault.h"
+# include "svm30lib.h"
+
+/**
+ * @brief constructor and initialize variables
+ */
+SVM30_fault::SVM30_fault(void) {
+    memset(&_Cfg, 0, sizeof(_Cfg));
+    memset(&_Stats, 0, sizeof(_Stats));
+    _I2C = NULL;
+    _Rand = 1;
+}
+
+/**
+ * @brief : set the faults to inject and the transport to use
+ *
+ * @param cfg : faults to inject
+ * @param transport : transport that performs the transactions
+ */
+void SVM30_fault::SetFault(struct fault_cfg *cfg, SVM30_I2C *transport) {
+    _Cfg = *cfg;
+    _I2C = transport;
+    memset(&_Stats, 0, sizeof(_Stats));
+
+    // xorshift can not start from zero
+    _Rand = _Cfg.seed ? _Cfg.seed : 1;
+}
+
+/**
+ * @brief : open the transport to inject faults on
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30_fault::Open() {
+
+    if (_I2C == NULL) return(false);
+
+    _I2C->EnableDebugging(_I2C_Debug);
+
+    return(_I2C->Open());
+}
+
+/**
+ * @brief : decide whether to inject a fault (xorshift32)
+ *
+ * @param chance : chance per 1000
+ *
+ * @return : true to inject
+ */
+bool SVM30_fault::Roll(uint16_t chance) {
+
+    if (chance == 0) return(false);
+
+    _Rand ^= _Rand << 13;
+    _Rand ^= _Rand >> 17;
+    _Rand ^= _Rand << 5;
+
+    return(_Rand % 1000 < chance);
+}
+
+/**
+ * @brief : inject latency and NACK before a transaction
+ *
+ * @param address : I2C address of device
+ *
+ * @return : ERR_NACK to skip the transaction else ERR_OK
+ */
+uint8_t SVM30_fault::Before(uint8_t address) {
+
+    _Stats.transactions++;
+
+    if (Roll(_Cfg.latency)) {
+        _Stats.latency++;
+        _I2C->Delay(_Cfg.delay);
+    }
+
+    if (Roll(_Cfg.nack)) {
+        _Stats.nack++;
+        if (_I2C_Debug) printf("Fault: NACK on 0x%02X\n", address);
+        return(ERR_NACK);
+    }
+
+    return(ERR_OK);
+}
+
+/**
+ * @brief : inject faults after the transaction has been performed
+ *
+ * @param ret : result of the transaction
+ * @param buf : bytes read (NULL if nothing was read)
+ * @param len : number of bytes read
+ *
+ * @return : result to report to the driver
+ */
+uint8_t SVM30_fault::After(uint8_t ret, uint8_t *buf, uint8_t len) {
+    uint8_t i;
+
+    if (Roll(_Cfg.clkt)) {
+        _Stats.clkt++;
+        if (_I2C_Debug) printf("Fault: clock stretch timeout\n");
+        return(ERR_PROTOCOL);
+    }
+
+    if (ret != ERR_OK || len == 0) return(ret);
+
+    if (Roll(_Cfg.shortread)) {
+        _Stats.shortread++;
+        i = _Rand % len;
+        if (_I2C_Debug) printf("Fault: short read, %d of %d bytes\n", i, len);
+        memset(buf + i, 0xFF, len - i);
+    }
+
+    if (Roll(_Cfg.crc)) {
+        _Stats.crc++;
+        i = _Rand % (len * 8);
+        if (_I2C_Debug) printf("Fault: bit %d flipped\n", i);
+        buf[i / 8] ^= 1 << (i % 8);
+    }
+
+    return(ret);
+}
+
+/**
+ * @brief : write to device with fault injection
+ */
+uint8_t SVM30_fault::Write(uint8_t address, uint8_t *buf, uint8_t len) {
+    uint8_t ret = Before(address);
+
+    if (ret != ERR_OK) return(ret);
+
+    ret = _I2C->Write(address, buf, len);
+
+    return(After(ret, NULL, 0));
+}
+
+/**
+ * @brief : read from device with fault injection
+ */
+uint8_t SVM30_fault::Read(uint8_t address, uint8_t *buf, uint8_t len) {
+    uint8_t ret = Before(address);
+
+    if (ret != ERR_OK) return(ret);
+
+    ret = _I2C->Read(address, buf, len);
+
+    return(After(ret, buf, len));
+}
+
+/**
+ * @brief : write and read in one transaction with fault injection
+ */
+uint8_t SVM30_fault::Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen) {
+    uint8_t ret = Before(address);
+
+    if (ret != ERR_OK) return(ret);
+
+    ret = _I2C->Transfer(address, wbuf, wlen, rbuf, rlen);
+
+    return(After(ret, rbuf, rlen));
+}
@@ -0,0 +1,120 @@
+/**
+ * SVM30 I2C fault injection Header file
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * SVM30_fault sits in between the driver and another transport and
+ * injects bus faults, driven by a seeded pseudo random generator. The
+ * same seed and settings result in the same faults at the same
+ * transactions, so a run against the simulator is reproducible.
+ *
+ * faults (each a chance per 1000 transactions) :
+ *  nack    : address not acknowledged, nothing is sent (ERR_NACK)
+ *  clkt    : clock stretch timeout, the device has handled the
+ *            transaction, the transport reports ERR_PROTOCOL
+ *  short   : the device releases the bus part way a read. The
+ *            remaining bytes read as 0xFF (ERR_OK).
+ *  crc     : one bit flipped in the bytes read (ERR_OK)
+ *  latency : extra delay before the transaction
+ *********************************************************************
+ */
+#ifndef SVM30_FAULT_H
+#define SVM30_FAULT_H
+
+# include "svm30i2c.h"
+
+/* fault settings */
+struct fault_cfg
+{
+    uint32_t seed;                  // seed for pseudo random generator
+    uint16_t nack;                  // chance per 1000 transactions
+    uint16_t clkt;
+    uint16_t shortread;
+    uint16_t crc;
+    uint16_t latency;
+    uint32_t delay;                 // latency to add (uS)
+};
+
+/* injected faults */
+struct fault_stats
+{
+    uint32_t transactions;          // transactions handled
+    uint32_t nack;
+    uint32_t clkt;
+    uint32_t shortread;
+    uint32_t crc;
+    uint32_t latency;
+};
+
+class SVM30_fault : public SVM30_I2C
+{
+  public:
+
+    SVM30_fault(void);
+
+    /**
+     * @brief set the faults to inject and the transport to use
+     *
+     * @param cfg : faults to inject
+     * @param transport : transport that performs the transactions
+     *
+     * Must be called before Open(). Resets the statistics.
+     */
+    void SetFault(struct fault_cfg *cfg, SVM30_I2C *transport);
+
+    /**
+     * @brief : return the number of injected faults
+     */
+    void GetStats(struct fault_stats *st) {*st = _Stats;}
+
+    bool Open();
+    void Close() {_I2C->Close();}
+    uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen);
+    void Delay(useconds_t us) {_I2C->Delay(us);}
+    void Elapsed(useconds_t us) {_I2C->Elapsed(us);}
+    bool Recover() {return(_I2C->Recover());}
+    void Lock() {_I2C->Lock();}
+    void Unlock() {_I2C->Unlock();}
+    void BusLock() {_I2C->BusLock();}
+    void BusUnlock() {_I2C->BusUnlock();}
+    void DeviceLock() {_I2C->DeviceLock();}
+    void DeviceUnlock() {_I2C->DeviceUnlock();}
+    void GetBusStats(struct bus_stats *st) {_I2C->GetBusStats(st);}
+    uint32_t BusTaken() {return(_I2C->BusTaken());}
+
+  private:
+    struct fault_cfg _Cfg;
+    struct fault_stats _Stats;
+    SVM30_I2C *_I2C;                // transport to inject faults on
+    uint32_t _Rand;                 // state pseudo random generator
+
+    bool Roll(uint16_t chance);
+    uint8_t Before(uint8_t address);
+    uint8_t After(uint8_t ret, uint8_t *buf, uint8_t len);
+};
+
+#endif /* SVM30_FAULT_H */
@@ -0,0 +1,102 @@
+/**
+ * SVM30 frame codec Header file
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * Both the SGP30 and SHTC1 send every data word (MSB first) followed by
+ * a CRC-8 (polynomial 0x31, init 0xFF). A response of N words is read
+ * from the bus straight into an svm30_frame<N>, CRC checked in place
+ * and decoded into the words of the caller. The frame size follows from
+ * the command descriptor (svm30cmd.h), so there is no fixed limit on the
+ * response length.
+ *********************************************************************
+ */
+#ifndef SVM30_FRAME_H
+#define SVM30_FRAME_H
+
+# include <stdint.h>
+
+/* CRC-8 lookup table, calculated at compile time */
+struct svm30_crc_table
+{
+    uint8_t t[256];
+
+    constexpr svm30_crc_table() : t() {
+        for (int i = 0; i < 256; i++) {
+            uint8_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x31) : (uint8_t) (crc << 1);
+            t[i] = crc;
+        }
+    }
+};
+
+constexpr svm30_crc_table SVM30_CRC;
+
+/**
+ * @brief : calculate CRC for I2C comms
+ * @param data : 2 databytes to calculate the CRC from
+ *
+ * @return CRC
+ */
+inline uint8_t svm30_crc8(const uint8_t *data) {
+    return(SVM30_CRC.t[SVM30_CRC.t[0xFF ^ data[0]] ^ data[1]]);
+}
+
+/**
+ * @brief : check the CRC of received words
+ * @param raw : received bytes (word + CRC)
+ * @param words : number of words in raw
+ *
+ * @return : number of correct words. Less than words means a CRC
+ * error on word [return value].
+ */
+inline uint8_t svm30_crc_check(const uint8_t *raw, uint8_t words) {
+    uint8_t i;
+
+    for (i = 0; i < words; i++, raw += 3) {
+        if (svm30_crc8(raw) != raw[2]) break;
+    }
+
+    return(i);
+}
+
+/* N response words, each followed by CRC, as received from the bus */
+template <uint8_t N> struct svm30_frame
+{
+    uint8_t raw[N * 3];
+
+    /**
+     * @brief : decode the words (MSB first), skipping the CRC
+     * @param w : store the words
+     */
+    void Decode(uint16_t (&w)[N]) const {
+        const uint8_t *p = raw;
+
+        for (uint8_t i = 0; i < N; i++, p += 3) w[i] = p[0] << 8 | p[1];
+    }
+};
+
+#endif /* SVM30_FRAME_H */
@@ -0,0 +1,682 @@
+/**
+ * SVM30 I2C transport
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha (moved from svm30lib.cpp)
+ *
+ * the embedded hardware I2C channel can be used as the SVM30 is
+ * not using clock stretching
+ *
+ * Next to the BCM2835 library, the Linux i2c-dev interface can be
+ * selected at build time (make I2C=dev). This will use ioctl(I2C_RDWR)
+ * on /dev/i2c-N, does not require root and will run on any Linux board
+ * with an I2C bus.
+ *********************************************************************
+ */
+
+# include "svm30lib.h"
+
+# include <fcntl.h>
+# include <errno.h>
+# include <time.h>
+# include <sys/file.h>
+
+#ifdef I2CDEV
+# include <sys/ioctl.h>
+# include <linux/i2c.h>
+# include <linux/i2c-dev.h>
+#else
+# include <bcm2835.h>
+#endif
+
+/*****************************************************************
+ * cross-process bus lock
+ ****************************************************************/
+
+/* advisory lock of a bus, one per bus in the process */
+struct bus_flock
+{
+    pthread_mutex_t mutex;      // protects this structure
+    int      fd;                // file to lock (-1 not opened yet)
+    uint32_t count;             // exchanges of this process in progress
+    struct bus_stats st;
+};
+
+/* start of the exchange of this thread (uS). A thread has one exchange
+ * at a time. */
+static thread_local uint64_t BusHoldStart;
+
+/**
+ * @brief : get monotonic time in uS
+ */
+static uint64_t bus_time()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/**
+ * @brief : open the file to lock for a bus
+ *
+ * @param l : lock of the bus
+ * @param bus : bus number
+ * @param debug : display debug messages
+ */
+static void bus_open(struct bus_flock *l, uint8_t bus, bool debug)
+{
+    char path[30];
+
+    // the i2c-dev node, so i2c-dev programs can use the same lock
+    sprintf(path, "/dev/i2c-%d", bus);
+    l->fd = open(path, O_RDONLY);
+
+    if (l->fd < 0) {
+        sprintf(path, "/run/lock/i2c-%d.lock", bus);
+        l->fd = open(path, O_RDONLY | O_CREAT, 0666);
+    }
+
+    if (l->fd < 0) {
+        if (debug) printf("No bus lock possible on %s : %s\n", path, strerror(errno));
+        l->fd = -2;         // do not try again
+    }
+}
+
+/**
+ * @brief : take the cross-process lock of a bus
+ *
+ * @param l : lock of the bus
+ * @param bus : bus number
+ * @param debug : display debug messages
+ *
+ * The flock belongs to the process, not to a thread. The first exchange
+ * of this process takes it, exchanges of other threads that start while
+ * it is held share it, the last one releases it. Threads of the process
+ * can so overlap their waits for the device, while other processes get
+ * the bus as soon as no exchange of this process is in progress. The
+ * statistics count the wait and hold time of each exchange.
+ */
+static void bus_claim(struct bus_flock *l, uint8_t bus, bool debug)
+{
+    uint64_t start, wait;
+
+    start = bus_time();
+
+    pthread_mutex_lock(&l->mutex);
+
+    // first exchange of this process : take the flock
+    if (l->count++ == 0) {
+
+        if (l->fd == -1) bus_open(l, bus, debug);
+
+        if (l->fd >= 0) {
+            while (flock(l->fd, LOCK_EX) < 0 && errno == EINTR);
+        }
+
+        l->st.taken++;
+    }
+
+    BusHoldStart = bus_time();
+    wait = BusHoldStart - start;
+
+    l->st.exchanges++;
+    l->st.wait += wait;
+    if (wait > l->st.wait_max) l->st.wait_max = wait;
+
+    pthread_mutex_unlock(&l->mutex);
+}
+
+/**
+ * @brief : release the cross-process lock of a bus
+ *
+ * @param l : lock of the bus
+ */
+static void bus_release(struct bus_flock *l)
+{
+    uint64_t hold = bus_time() - BusHoldStart;
+
+    pthread_mutex_lock(&l->mutex);
+
+    l->st.hold += hold;
+    if (hold > l->st.hold_max) l->st.hold_max = hold;
+
+    // last exchange of this process : let other processes use the bus
+    if (l->count > 0 && --l->count == 0 && l->fd >= 0) flock(l->fd, LOCK_UN);
+
+    pthread_mutex_unlock(&l->mutex);
+}
+
+/**
+ * @brief : return the statistics of the lock of a bus
+ *
+ * @param l : lock of the bus
+ * @param st : store the statistics
+ */
+static void bus_stats(struct bus_flock *l, struct bus_stats *st)
+{
+    pthread_mutex_lock(&l->mutex);
+    *st = l->st;
+    pthread_mutex_unlock(&l->mutex);
+}
+
+/**
+ * @brief : return the number of times the flock of a bus was taken
+ *
+ * @param l : lock of the bus
+ */
+static uint32_t bus_taken(struct bus_flock *l)
+{
+    uint32_t taken;
+
+    pthread_mutex_lock(&l->mutex);
+    taken = l->st.taken;
+    pthread_mutex_unlock(&l->mutex);
+
+    return(taken);
+}
+
+#ifdef I2CDEV
+
+/* one lock per bus, shared by all objects on that bus. Open() refuses a
+ * bus number of I2C_MAX_BUS or above, until then such a bus uses the
+ * spare last entry. */
+#define I2C_MAX_BUS 16
+
+static pthread_mutex_t BusMutex[I2C_MAX_BUS + 1];
+static struct bus_flock BusFlock[I2C_MAX_BUS + 1];
+static pthread_once_t BusLockOnce = PTHREAD_ONCE_INIT;
+
+static void init_buslock()
+{
+    for (int i = 0; i <= I2C_MAX_BUS; i++) {
+        pthread_mutex_init(&BusMutex[i], NULL);
+        pthread_mutex_init(&BusFlock[i].mutex, NULL);
+        BusFlock[i].fd = -1;
+    }
+}
+
+/**
+ * @brief : return the lock entry of a bus
+ */
+static int bus_slot(uint8_t bus)
+{
+    return(bus < I2C_MAX_BUS ? bus : I2C_MAX_BUS);
+}
+
+/**
+ * @brief : claim / release the bus
+ */
+void SVM30_i2cdev::Lock()
+{
+    pthread_once(&BusLockOnce, init_buslock);
+    pthread_mutex_lock(&BusMutex[bus_slot(_bus)]);
+}
+
+void SVM30_i2cdev::Unlock()
+{
+    pthread_mutex_unlock(&BusMutex[bus_slot(_bus)]);
+}
+
+/**
+ * @brief : claim / release the bus against other processes
+ */
+void SVM30_i2cdev::BusLock()
+{
+    pthread_once(&BusLockOnce, init_buslock);
+    bus_claim(&BusFlock[bus_slot(_bus)], _bus, _I2C_Debug);
+}
+
+void SVM30_i2cdev::BusUnlock()
+{
+    bus_release(&BusFlock[bus_slot(_bus)]);
+}
+
+void SVM30_i2cdev::GetBusStats(struct bus_stats *st)
+{
+    pthread_once(&BusLockOnce, init_buslock);
+    bus_stats(&BusFlock[bus_slot(_bus)], st);
+}
+
+uint32_t SVM30_i2cdev::BusTaken()
+{
+    pthread_once(&BusLockOnce, init_buslock);
+    return(bus_taken(&BusFlock[bus_slot(_bus)]));
+}
+
+/**
+ * @brief constructor and initialize variables
+ */
+SVM30_i2cdev::SVM30_i2cdev(void) {
+    _bus = I2C_DEFAULT_BUS;
+    _fd = -1;
+}
+
+/**
+ * @brief : Start I2C communication
+ * 
+ * @return
+ * All good : true
+ * false : error
+ * 
+ */
+bool SVM30_i2cdev::Open()
+{
+    char dev[20];
+
+    if (_bus >= I2C_MAX_BUS) {
+        printf("Bus %d not supported (maximum %d)\n", _bus, I2C_MAX_BUS - 1);
+        return(false);
+    }
+
+    sprintf(dev, "/dev/i2c-%d", _bus);
+
+    _fd = open(dev, O_RDWR);
+
+    if (_fd < 0) {
+        printf("Can't open %s : %s\n", dev, strerror(errno));
+        return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief : perform I2C transaction(s) on i2c-dev
+ * 
+ * @param msgs : messages to handle (each starts with (repeated) start)
+ * @param num : number of messages
+ *  
+ * @return
+ * All good : ERR_OK
+ * else error
+ */
+uint8_t SVM30_i2cdev::Rdwr(struct i2c_msg *msgs, int num)
+{
+    struct i2c_rdwr_ioctl_data data;
+
+    data.msgs = msgs;
+    data.nmsgs = num;
+
+    if (ioctl(_fd, I2C_RDWR, &data) == num) return(ERR_OK);
+
+    switch(errno)
+    {
+        case ENXIO:
+        case EREMOTEIO:
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: NACK error\n");
+            return(ERR_NACK);
+            break;
+
+        case ETIMEDOUT:
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: Clock stretch error\n");
+            break;
+
+        default:
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: I2C transaction error\n");
+            break;
+    }
+
+    return(ERR_PROTOCOL);
+}
+
+/**
+ * @brief : read from device
+ * 
+ * @param address : I2C address of device
+ * @param buf : buffer to store bytes
+ * @param len : number of bytes to read
+ *  
+ * @return
+ * All good : ERR_OK
+ * else error
+ */
+uint8_t SVM30_i2cdev::Read(uint8_t address, uint8_t *buf, uint8_t len)
+{
+    struct i2c_msg msg;
+
+    msg.addr = address;
+    msg.flags = I2C_M_RD;
+    msg.len = len;
+    msg.buf = buf;
+
+    return(Rdwr(&msg, 1));
+}
+
+/**
+ * @brief : write to Device
+ * 
+ * @param address : I2C address of device
+ * @param buf : bytes to write
+ * @param len : number of bytes to write
+ * 
+ * @return : Success is ERR_OK, else error
+ */
+uint8_t SVM30_i2cdev::Write(uint8_t address, uint8_t *buf, uint8_t len)
+{
+    struct i2c_msg msg;
+
+    msg.addr = address;
+    msg.flags = 0;
+    msg.len = len;
+    msg.buf = buf;
+
+    return(Rdwr(&msg, 1));
+}
+
+/**
+ * @brief : write to Device and read the response in one kernel
+ * transaction (repeated start)
+ * 
+ * @return : Success is ERR_OK, else error
+ */
+uint8_t SVM30_i2cdev::Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen)
+{
+    struct i2c_msg msgs[2];
+
+    msgs[0].addr = address;
+    msgs[0].flags = 0;
+    msgs[0].len = wlen;
+    msgs[0].buf = wbuf;
+
+    msgs[1].addr = address;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = rlen;
+    msgs[1].buf = rbuf;
+
+    return(Rdwr(msgs, 2));
+}
+
+/**
+ * @brief : close I2C device
+ */
+void SVM30_i2cdev::Close()
+{
+    if (_fd < 0) return;
+
+    close(_fd);
+    _fd = -1;
+}
+
+#else // BCM2835
+
+/* the BCM2835 library has one bus for the whole process. It is opened by
+ * the first object and closed by the last. */
+static pthread_mutex_t BcmLock = PTHREAD_MUTEX_INITIALIZER;
+static struct bus_flock BcmFlock = {PTHREAD_MUTEX_INITIALIZER, -1, 0, {0, 0, 0, 0, 0, 0}};
+static uint8_t BcmOpen = 0;
+
+/**
+ * @brief : claim / release the bus
+ */
+void SVM30_bcm2835::Lock()
+{
+    pthread_mutex_lock(&BcmLock);
+}
+
+void SVM30_bcm2835::Unlock()
+{
+    pthread_mutex_unlock(&BcmLock);
+}
+
+/**
+ * @brief : claim / release the bus against other processes
+ */
+void SVM30_bcm2835::BusLock()
+{
+    bus_claim(&BcmFlock, I2C_DEFAULT_BUS, _I2C_Debug);
+}
+
+void SVM30_bcm2835::BusUnlock()
+{
+    bus_release(&BcmFlock);
+}
+
+void SVM30_bcm2835::GetBusStats(struct bus_stats *st)
+{
+    bus_stats(&BcmFlock, st);
+}
+
+uint32_t SVM30_bcm2835::BusTaken()
+{
+    return(bus_taken(&BcmFlock));
+}
+
+/**
+ * @brief : Start I2C communication
+ * 
+ * @return
+ * All good : true
+ * false : error
+ * 
+ */
+bool SVM30_bcm2835::Open()
+{
+    // already opened by another object
+    if (BcmOpen > 0) {
+        BcmOpen++;
+        return(true);
+    }
+
+     if (!bcm2835_init()) {
+        printf("Can't init bcm2835!\n");
+        return(false);
+    }
+
+    // will select I2C channel 0 or 1 depending on board version.
+    if (!bcm2835_i2c_begin()) {
+        printf("Can't setup I2c pin!\n");
+        
+        // release BCM2835 library
+        bcm2835_close();
+        return(false);
+    }
+    
+    /* set BSC speed to 100Khz*/
+    bcm2835_i2c_setClockDivider(BCM2835_I2C_CLOCK_DIVIDER_2500);
+
+    BcmOpen++;
+   
+    return(true);
+}
+
+/**
+ * @brief : read from device
+ * 
+ * @param address : I2C address of device
+ * @param buf : buffer to store bytes
+ * @param len : number of bytes to read
+ *  
+ * @return
+ * All good : ERR_OK
+ * else error
+ * 
+ */
+uint8_t SVM30_bcm2835::Read(uint8_t address, uint8_t *buf, uint8_t len)
+{
+    /* set slaveaddress */
+    bcm2835_i2c_setSlaveAddress(address);
+
+    switch(bcm2835_i2c_read((char *) buf, len))
+    {
+        case BCM2835_I2C_REASON_ERROR_NACK :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: Read NACK error\n");
+            return(ERR_NACK);
+            break;
+
+        case BCM2835_I2C_REASON_ERROR_CLKT :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: Read Clock stretch error\n");
+            return(ERR_PROTOCOL);
+            break;
+
+        case BCM2835_I2C_REASON_ERROR_DATA :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: not all data has been read\n");
+            return(ERR_PROTOCOL);
+            break;
+    }
+    
+    return(ERR_OK);
+}
+
+/**
+ * @brief : write to Device
+ * 
+ * @param address : I2C address of device
+ * @param buf : bytes to write
+ * @param len : number of bytes to write
+ * 
+ * @return : Success is ERR_OK, else error
+ */
+uint8_t SVM30_bcm2835::Write(uint8_t address, uint8_t *buf, uint8_t len)
+{
+    /* set slaveaddress */
+    bcm2835_i2c_setSlaveAddress(address);
+ 
+    switch(bcm2835_i2c_write( (char*) buf, len))
+    {
+        case BCM2835_I2C_REASON_ERROR_NACK :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: Write NACK error\n");
+            return(ERR_NACK);
+            break;
+
+        case BCM2835_I2C_REASON_ERROR_CLKT :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: Write Clock stretch error\n");
+            return(ERR_PROTOCOL);
+            break;
+
+        case BCM2835_I2C_REASON_ERROR_DATA :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: not all data has been written\n");
+            return(ERR_PROTOCOL);
+            break;
+    }
+    
+    return(ERR_OK);
+}
+
+/**
+ * @brief : write to Device and read the response in one
+ * transaction (repeated start)
+ * 
+ * @return : Success is ERR_OK, else error
+ */
+uint8_t SVM30_bcm2835::Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen)
+{
+    /* set slaveaddress */
+    bcm2835_i2c_setSlaveAddress(address);
+ 
+    switch(bcm2835_i2c_write_read_rs((char*) wbuf, wlen, (char *) rbuf, rlen))
+    {
+        case BCM2835_I2C_REASON_ERROR_NACK :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: Transfer NACK error\n");
+            return(ERR_NACK);
+            break;
+
+        case BCM2835_I2C_REASON_ERROR_CLKT :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: Transfer Clock stretch error\n");
+            return(ERR_PROTOCOL);
+            break;
+
+        case BCM2835_I2C_REASON_ERROR_DATA :
+            if(_I2C_Debug) printf(REDSTR,"DEBUG: not all data has been transferred\n");
+            return(ERR_PROTOCOL);
+            break;
+    }
+    
+    return(ERR_OK);
+}
+
+/* I2C pins (Raspberry Pi V2 and later) and half a clock at 100Khz */
+#define SDA_PIN     RPI_V2_GPIO_P1_03
+#define SCL_PIN     RPI_V2_GPIO_P1_05
+#define HALF_CLOCK  5
+
+/**
+ * @brief : release a pin (pulled high) or drive it low
+ */
+static void bus_pin(uint8_t pin, bool high)
+{
+    if (high) bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
+    else {
+        bcm2835_gpio_write(pin, LOW);
+        bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_OUTP);
+    }
+
+    bcm2835_delayMicroseconds(HALF_CLOCK);
+}
+
+/**
+ * @brief : recover the bus when a device holds SDA low
+ *
+ * The pins are taken from the BSC controller and driven as GPIO : 9
+ * clock pulses let the device shift out the rest of a byte and see a
+ * NACK, followed by a STOP condition.
+ *
+ * @return : true if SDA is released
+ */
+bool SVM30_bcm2835::Recover()
+{
+    uint8_t i;
+    bool ret;
+
+    // release pins from BSC (set to input)
+    bcm2835_i2c_end();
+
+    for (i = 0; i < 9; i++) {
+        bus_pin(SCL_PIN, false);
+        bus_pin(SCL_PIN, true);
+    }
+
+    // STOP : SDA goes high while SCL is high
+    bus_pin(SCL_PIN, false);
+    bus_pin(SDA_PIN, false);
+    bus_pin(SCL_PIN, true);
+    bus_pin(SDA_PIN, true);
+
+    ret = bcm2835_gpio_lev(SDA_PIN) == HIGH;
+
+    if(_I2C_Debug) printf("DEBUG: bus recovery %s\n", ret ? "done" : "failed, SDA still low");
+
+    // back to BSC controller
+    bcm2835_i2c_begin();
+    bcm2835_i2c_setClockDivider(BCM2835_I2C_CLOCK_DIVIDER_2500);
+
+    return(ret);
+}
+
+/**
+ * @brief : close library and reset pins.
+ */
+void SVM30_bcm2835::Close()
+{
+    // still in use by another object
+    if (BcmOpen == 0 || --BcmOpen > 0) return;
+
+    // reset pins
+    bcm2835_i2c_end();  
+    
+    // release BCM2835 library
+    bcm2835_close();
+}
+
+#endif // I2CDEV
@@ -0,0 +1,283 @@
+/**
+ * SVM30 I2C transport Header file
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * All bus access of the SVM30 driver goes through an SVM30_I2C
+ * transport. The driver only knows the interface below, which makes
+ * it possible to replace the hardware by another bus interface or by
+ * a simulation (see svm30sim.h).
+ *********************************************************************
+ */
+#ifndef SVM30_I2C_H
+#define SVM30_I2C_H
+
+# include <stdio.h>
+# include <unistd.h>
+# include <stdint.h>
+# include <string.h>
+# include <pthread.h>
+
+// default I2C bus for i2c-dev (/dev/i2c-1 on a Raspberry Pi)
+#define I2C_DEFAULT_BUS 1
+
+/* cross-process bus lock statistics */
+struct bus_stats
+{
+    uint32_t exchanges;         // exchanges with the bus locked
+    uint32_t taken;             // times the flock was taken (not shared)
+    uint64_t wait;              // total time waiting for the lock (uS)
+    uint64_t wait_max;          // longest wait (uS)
+    uint64_t hold;              // total time holding the lock (uS)
+    uint64_t hold_max;          // longest hold (uS)
+};
+
+class SVM30_I2C
+{
+  public:
+
+    SVM30_I2C(void) {_I2C_Debug = false; pthread_mutex_init(&_Lock, NULL); pthread_mutex_init(&_Device, NULL);}
+    virtual ~SVM30_I2C() {pthread_mutex_destroy(&_Lock); pthread_mutex_destroy(&_Device);}
+
+    /**
+     * @brief  Enable or disable the printing of debug messages.
+     */
+    void EnableDebugging(bool act) {_I2C_Debug = act;}
+
+    /**
+     * @brief : open / start the I2C communication
+     *
+     * @return :
+     *   true on success else false
+     */
+    virtual bool Open() = 0;
+
+    /**
+     * @brief : close the I2C communication
+     */
+    virtual void Close() = 0;
+
+    /**
+     * @brief : write to device
+     *
+     * @param address : I2C address of device
+     * @param buf : bytes to write
+     * @param len : number of bytes to write
+     *
+     * @return :
+     *   ERR_OK on success, ERR_NACK if not acknowledged, else error
+     */
+    virtual uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len) = 0;
+
+    /**
+     * @brief : read from device
+     *
+     * @param address : I2C address of device
+     * @param buf : buffer to store bytes
+     * @param len : number of bytes to read
+     *
+     * @return :
+     *   ERR_OK on success, ERR_NACK if not acknowledged, else error
+     */
+    virtual uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len) = 0;
+
+    /**
+     * @brief : write to device and read the response in one
+     * transaction (repeated start)
+     *
+     * @param address : I2C address of device
+     * @param wbuf : bytes to write
+     * @param wlen : number of bytes to write
+     * @param rbuf : buffer to store bytes
+     * @param rlen : number of bytes to read
+     *
+     * @return :
+     *   ERR_OK on success else error
+     */
+    virtual uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen) = 0;
+
+    /**
+     * @brief : wait for the device to handle a command
+     *
+     * @param us : time to wait in micro seconds
+     *
+     * A transport that does not talk to real hardware can replace
+     * this to run at full speed.
+     */
+    virtual void Delay(useconds_t us) {usleep(us);}
+
+    /**
+     * @brief : time has passed without Delay() (asynchronous API)
+     *
+     * @param us : time passed in micro seconds
+     *
+     * The driver waited outside the transport, e.g. on the timer of
+     * SVM30::ReadyFd(). A transport that keeps its own clock instead
+     * of sleeping in Delay() advances it here.
+     */
+    virtual void Elapsed(useconds_t us) {}
+
+    /**
+     * @brief : recover a bus where a device holds SDA low (e.g. after
+     * an aborted read) by sending 9 clock pulses and a STOP condition
+     *
+     * @return :
+     *   true if the bus is free, false if it is not or recovery is not
+     *   supported by the transport
+     */
+    virtual bool Recover() {return(false);}
+
+    /**
+     * @brief : claim / release the bus for an exchange
+     *
+     * The driver holds the lock for a command and its response. Every
+     * object that uses the same bus must share the lock : a transport
+     * that wraps another transport passes the call on, and the hardware
+     * transports use one lock per bus for all objects.
+     */
+    virtual void Lock() {pthread_mutex_lock(&_Lock);}
+    virtual void Unlock() {pthread_mutex_unlock(&_Lock);}
+
+    /**
+     * @brief : claim / release the bus against other processes
+     *
+     * Taken by the driver before Lock() for one command, wait and
+     * response exchange, and released after Unlock(). Lock() is released
+     * while waiting for the device, this lock is not. The hardware
+     * transports take an advisory flock() on /dev/i2c-N (or
+     * /run/lock/i2c-N.lock). The threads of a process share it : it is
+     * taken by the first exchange and released when no exchange of the
+     * process is in progress, so threads still overlap their waits while
+     * another process can not come in between. Other programs on the bus
+     * can take the same flock.
+     */
+    virtual void BusLock() {}
+    virtual void BusUnlock() {}
+
+    /**
+     * @brief : claim / release the device for an exchange
+     *
+     * Taken by the driver before BusLock() and held for the whole
+     * command, wait and response, also while Lock() is released. No
+     * other exchange can reach the device between a command and its
+     * response. The transport object that talks to the device (a
+     * hardware bus, the simulator or a multiplexer port) owns the lock,
+     * a transport that wraps another transport passes the call on.
+     */
+    virtual void DeviceLock() {pthread_mutex_lock(&_Device);}
+    virtual void DeviceUnlock() {pthread_mutex_unlock(&_Device);}
+
+    /**
+     * @brief : return the statistics of the cross-process lock
+     */
+    virtual void GetBusStats(struct bus_stats *st) {memset(st, 0, sizeof(struct bus_stats));}
+
+    /**
+     * @brief : return the number of times the cross-process lock was taken
+     *
+     * Stays the same while this process holds the lock without a break.
+     * When it changes, another process may have used the bus (e.g. to
+     * switch a multiplexer). Without a cross-process lock it is 0.
+     */
+    virtual uint32_t BusTaken() {return(0);}
+
+  protected:
+    bool _I2C_Debug;            // display debug messages
+    pthread_mutex_t _Lock;      // lock of this transport
+    pthread_mutex_t _Device;    // lock of the device behind this transport
+};
+
+#ifdef I2CDEV
+
+struct i2c_msg;
+
+/* Linux i2c-dev interface (/dev/i2c-N), no root needed */
+class SVM30_i2cdev : public SVM30_I2C
+{
+  public:
+
+    SVM30_i2cdev(void);
+
+    /**
+     * @brief  Select the I2C bus to use (/dev/i2c-N) before Open()
+     */
+    void SetBus(uint8_t bus) {_bus = bus;}
+
+    /**
+     * @brief : bus recovery is left to the kernel
+     *
+     * i2c-dev has no request to drive SCL from user space. An adapter
+     * driver that supports recovery (e.g. i2c-designware, i2c-imx)
+     * clocks the bus free itself (i2c_recover_bus()) when a transfer
+     * times out or loses arbitration, before the error is returned. On
+     * other adapters a device holding SDA low stays stuck until power
+     * is cycled.
+     *
+     * @return : true, the command can be repeated
+     */
+    bool Recover() {return(true);}
+
+    bool Open();
+    void Close();
+    uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen);
+    void Lock();
+    void Unlock();
+    void BusLock();
+    void BusUnlock();
+    void GetBusStats(struct bus_stats *st);
+    uint32_t BusTaken();
+
+  private:
+    uint8_t _bus;               // bus number
+    int     _fd;                // file descriptor of /dev/i2c-N
+    uint8_t Rdwr(struct i2c_msg *msgs, int num);
+};
+
+#else
+
+/* BCM2835 library (Raspberry Pi only, needs root) */
+class SVM30_bcm2835 : public SVM30_I2C
+{
+  public:
+
+    bool Open();
+    void Close();
+    uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen);
+    bool Recover();
+    void Lock();
+    void Unlock();
+    void BusLock();
+    void BusUnlock();
+    void GetBusStats(struct bus_stats *st);
+    uint32_t BusTaken();
+};
+
+#endif // I2CDEV
+
+#endif /* SVM30_I2C_H */
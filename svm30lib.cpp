@@ -48,10 +48,45 @@
  *
  * - added raw boolean (default true) to include(true) / exclude (false) raw data
  * - added read-delay setting based on the kind of command request.
+ *
+ * Version 1.3 / October 2026
+ * - added Linux i2c-dev (/dev/i2c-N) interface as alternative to BCM2835 (make I2C=dev)
+ * - added combined write/read transaction (repeated start) for commands without wait
+ * - added pluggable I2C transport (svm30i2c.h) and SVM30 simulator (svm30sim.h)
+ * - added readiness polling instead of fixed wait after a command
+ * - added compile-time command descriptors (svm30cmd.h)
+ * - added frame codec with table driven CRC (svm30frame.h), no limit on response length
+ * - added I2C capture and replay (svm30capture.h)
+ * - added I2C fault injection (svm30fault.h)
+ * - added retry with backoff and bus recovery for failed commands
+ * - added TCA9548A multiplexer support (svm30mux.h)
+ * - added per bus locking, SVM30 objects can be used from different threads
+ * - begin() no longer does a general call reset, only device specific resets
+ * - added hot-unplug detection and resume with last known baselines / humidity
+ * - added cross-process bus lock (flock) for each exchange
+ * - added pipelined SGP30 / SHTC1 measurements in GetValues()
+ * - added measurement per signal, Sample() with interval per signal and time stamps
+ * - added sampler thread with absolute 1Hz deadlines and jitter statistics
+ * - added min / max / mean / median of the 1Hz CO2eq / TVOC readings
+ * - added asynchronous state machine API with a pollable timerfd
+ * - added GetDue() and GetAggregate() for callers with their own timer
+ * - added quality per field (failed, CRC, stale, warm-up, out of range),
+ *   GetValues() continues after a failed field
+ * - added attach mode : begin() continues with a measuring SGP30
+ * - added baseline store : hourly checkpoint per SGP30 serial, restore at begin()
+ * - added baseline cache : one Get_Baseline per GetBaseLines(), one Set_Baseline
+ *   for either half, GetCachedBaseLines() for periodic display
+ * - added humidity compensation controller (SetHumidityComp()), corrected
+ *   the 8.8 fixed point encoding of the absolute humidity
+ * - added capabilities read by begin() (GetCaps()), commands the SGP30
+ *   feature set does not support are skipped
  *********************************************************************
  */
 
 # include "svm30lib.h"
+# include <sys/timerfd.h>
+# include <fcntl.h>
+# include <limits.h>
 
 const char * SVM30_VERSION = VERSION;
 
@@ -60,10 +95,105 @@ const char * SVM30_VERSION = VERSION;
  */
 SVM30::SVM30(void) {
   _Send_BUF_Length = 0;
-  _Receive_BUF_Length = 0;
   _SVM30_Debug = false;
   _started = false;
+  _InitTime = 0;
   _SelectTemp = true;          // default to celsius
+  _I2C = &_DefaultI2C;
+  _Polling = false;
+  _Pipelined = false;
+  _Attach = false;
+  _Attached = false;
+  _StoreDir = NULL;
+  _StoreFrom = _StoreNext = 0;
+  _Restored = false;
+  _Waited = 0;
+  _Cmd = NULL;
+  memset(&_Retry, 0, sizeof(_Retry));
+  memset(&_Caps, 0, sizeof(_Caps));
+  _RetryWaited = 0;
+  _Present = true;
+  _NackFail = 0;
+  _LastProbe = 0;
+  _Baseline[0] = _Baseline[1] = 0;
+  _BaseCache[0] = _BaseCache[1] = 0;
+  _BaseRead = 0;
+  _Humidity = 0;
+  _HumSent = 0;
+  _HumTarget = 0;
+  _HumComp = false;
+  memset(&_Schedule, 0, sizeof(_Schedule));
+  memset(_Due, 0, sizeof(_Due));
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&_Api, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  // WaitSample() timeouts are on the same clock as the sampler
+  pthread_condattr_t cattr;
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&_SampleCond, &cattr);
+  pthread_condattr_destroy(&cattr);
+
+  pthread_mutex_init(&_SampleLock, NULL);
+  _SamplerRun = false;
+  _SamplerStop = false;
+  _Period = 1000;
+  memset(&_Latest, 0, sizeof(_Latest));
+  _SampleDone = _SampleDue = 0;
+  memset(&_SamplerStats, 0, sizeof(_SamplerStats));
+  memset(&_Agg, 0, sizeof(_Agg));
+  _AggSum[0] = _AggSum[1] = 0;
+  _TimerFd = -1;
+  _Async = ASYNC_IDLE;
+  _Steps = 0;
+  _AsyncClock = 0;
+}
+
+/**
+ * @brief destructor
+ *
+ * The mutexes and condition are not destroyed : when exit() is called
+ * from a signal handler, the interrupted thread may still wait on them.
+ */
+SVM30::~SVM30() {
+  StopSampler();
+  if (_TimerFd >= 0) ::close(_TimerFd);
+}
+
+/**
+ * @brief : Enable or disable readiness polling
+ *
+ * @param act :
+ *  false : fixed wait after command
+ *  true : poll for result
+ */
+void SVM30::SetReadyPolling(bool act) {
+    _Polling = act;
+}
+
+/**
+ * @brief : select the I2C bus to use (i2c-dev only)
+ *
+ * @param bus : bus number of /dev/i2c-N
+ */
+void SVM30::SetI2CBus(uint8_t bus) {
+#ifdef I2CDEV
+    _DefaultI2C.SetBus(bus);
+#endif
+}
+
+/**
+ * @brief : select the I2C transport to use
+ *
+ * @param transport : transport or NULL for the default
+ */
+void SVM30::SetTransport(SVM30_I2C *transport) {
+    if (transport == NULL) _I2C = &_DefaultI2C;
+    else _I2C = transport;
 }
 
 /**
@@ -77,17 +207,79 @@ bool SVM30::StartSGP30() {
 
     if (! _started) {
 
-        PrepSendBuffer(SGP30_ADDRESS, SGP30_Init_Air_Quality);
-
         // send request (no response expected)
-        if (SendToSVM() != ERR_OK) {
+        if (Command<CMD_SGP30_Init_Air_Quality>() != ERR_OK) {
             if (_SVM30_Debug) printf("Error during requesting init Air Quality\n");
             return(false);
         }
         if (_SVM30_Debug) printf(" No responds expected\n");
         _started = true;
+        _InitTime = GetTime();
+
+        // the IAQ algorithm starts with zero baselines
+        _BaseRead = 0;
+
+        // send the humidity compensation again
+        _HumSent = 0;
+    }
+
+    return(true);
+}
+
+/**
+ * @brief : check whether an absent SVM30 is back and re-initialize
+ *
+ * @return
+ *   true if the SVM30 is present, else false
+ */
+bool SVM30::Resume() {
+    time_t now = time(NULL);
+    svm30_frame<CMD_SHTC1_Read_ID.resp> frame;
+    struct svm_caps caps;
+    uint8_t ret;
+
+    if (_Present) return(true);
+
+    // probe at a low rate
+    if (now - _LastProbe < PROBE_INTERVAL) return(false);
+    _LastProbe = now;
+
+    // one attempt without retries : the probe of an absent SVM30 must
+    // not stall the caller (e.g. an event loop)
+    Claim();
+    PrepSendBuffer(CMD_SHTC1_Read_ID);
+    ret = RequestFromSVM(frame.raw, sizeof(frame.raw));
+    Release();
+
+    if (ret != ERR_OK) return(false);
+
+    // it can be another SVM30 : read the capabilities again. Until
+    // it answers, the last known capabilities stay valid
+    if (! ReadCaps(&caps)) return(false);
+    _Caps = caps;
+
+    if (_SVM30_Debug) printf("SVM30 is back, re-initialize\n");
+
+    _Present = true;
+    _NackFail = 0;
+
+    // after power loss the SGP30 needs Init_Air_Quality
+    reset(SGP30);
+    if (! StartSGP30()) return(false);
+
+    // restore last known state
+    if (_Baseline[0] != 0 && _Baseline[1] != 0) {
+        uint16_t base[2] = {_Baseline[0], _Baseline[1]};
+        WriteBaseLines(base);
+    }
+
+    if (_Humidity != 0) {
+        uint16_t data[1] = {_Humidity};
+        if (Command<CMD_SGP30_Set_Humidity>(data) == ERR_OK) HumiditySent(_Humidity);
     }
 
+    _Retry.resumed++;
+
     return(true);
 }
 
@@ -98,15 +290,78 @@ bool SVM30::StartSGP30() {
  *   true on success else false
  */
 bool SVM30::begin() {
-    
+    svm30_guard g(&_Api);
+
     if (! I2C_init()) return(false);
 
+    // ID's and feature set, read once
+    ReadCaps(&_Caps);
+
+    // keep the IAQ algorithm of a measuring SGP30
+    if (_Attach && Attach()) {
+        StoreStart(true);
+        return(true);
+    }
+
+    // 1.3 : no general call reset, it would reset all devices on the bus.
+    // The SHTC1 is only reset when it does not respond.
+    if (! _Caps.shtc1) {
+        reset(SHTC1);
+        ReadCaps(&_Caps);
+    }
+
+    // (re)start the IAQ algorithm of the SGP30
     reset(SGP30);
-    
-    reset(SHTC1);
 
-    // start SGP30
-    return(StartSGP30());
+    if (! StartSGP30()) return(false);
+
+    // restore the stored baseline
+    StoreStart(false);
+
+    return(true);
+}
+
+/**
+ * @brief : continue with an SGP30 that is already measuring
+ *
+ * Both devices must answer with a valid ID and the SGP30 must report
+ * product type 0 (SGP30). The IAQ algorithm only reports a baseline
+ * after Init_Air_Quality and the 15 seconds warm-up, so a baseline
+ * other than zero means it is running. Otherwise begin() starts it.
+ *
+ * @return :
+ *   true if attached else false
+ */
+bool SVM30::Attach() {
+    uint16_t base[2];
+
+    _Attached = false;
+
+    // SHTC1 : bit 5:0 of the ID are the product code
+    if (! _Caps.shtc1 || (_Caps.shtc1_id & 0x3F) != 0x07) {
+        if (_SVM30_Debug) printf("Attach : no SHTC1\n");
+        return(false);
+    }
+
+    if (! _Caps.sgp30 || _Caps.type != 0) {
+        if (_SVM30_Debug) printf("Attach : no SGP30\n");
+        return(false);
+    }
+
+    // also kept to restore after hot-unplug
+    if (! ReadBaseLines(base) || base[0] == 0 || base[1] == 0) {
+        if (_SVM30_Debug) printf("Attach : SGP30 is not measuring\n");
+        return(false);
+    }
+
+    if (_SVM30_Debug) printf("Attach : SGP30 is measuring, baseline TVOC 0x%04X CO2eq 0x%04X\n", base[0], base[1]);
+
+    // past the warm-up, no Init_Air_Quality
+    _started = true;
+    _InitTime = 0;
+    _Attached = true;
+
+    return(true);
 }
 
 /**
@@ -138,22 +393,33 @@ const char * SVM30::GetDriverVersion() {
  *   true on success else false
  */
 bool SVM30::reset(uint8_t device) {
+    svm30_guard g(&_Api);
     
     uint8_t ret;
     
-    if (device == SGP30_ADDRESS){
-        PrepSendBuffer(RESET_ADDRESS, RESET_CMD);
-        if (_SVM30_Debug) printf("WARNING: reset ALL devices on I2C\n");
+    // 1.3 : the SGP30 has no device specific reset. Init_Air_Quality
+    // restarts the IAQ algorithm, which is sent by StartSGP30().
+    if (device == SGP30_ADDRESS) {
+        _started = false;
+        return(true);
     }
 
-    else if (device == SHTC1_ADDRESS)
-        PrepSendBuffer(SHTC1_ADDRESS, SHTC1_Reset);
+    // soft reset, the settle time is part of the command descriptor
+    if (device == SHTC1_ADDRESS) {
 
-    else
-        return(false);
+        if (Command<CMD_SHTC1_Reset>() != ERR_OK) {
+            if (_SVM30_Debug) printf("Error on reset SHTC1\n");
+            return(false);
+        }
+
+        return(true);
+    }
+
+    if (device != RESET_ADDRESS) return(false);
 
     // send Request to sensor
-    ret = SendToSVM();
+    if (_SVM30_Debug) printf("WARNING: reset ALL devices on I2C\n");
+    ret = Command<CMD_General_Call_Reset>();
     
     if (ret != ERR_OK) {
        if (_SVM30_Debug) printf("Error on reset (which can be normal)\n");
@@ -163,7 +429,7 @@ bool SVM30::reset(uint8_t device) {
     }
     
     // give time to settle reset
-    delay(500);
+    _I2C->Delay(500000);
 
     _started = false;
 
@@ -179,22 +445,84 @@ bool SVM30::reset(uint8_t device) {
  *   true on success else false
  */
 bool SVM30::GetFeatureSet(char *buf) {
-    
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Get_Feature_Set);
+    svm30_guard g(&_Api);
+    uint16_t fs[1];
 
     // send Request and read from sensor
-    if (RequestFromSVM(2) != ERR_OK) {
+    if (Request<CMD_SGP30_Get_Feature_Set>(fs) != ERR_OK) {
         if (_SVM30_Debug) printf("Error during reading Feature set\n");
         return(false);
     }
 
     // copy feature set
-    buf[0] = _Receive_BUF[0];
-    buf[1] = _Receive_BUF[1];
+    buf[0] = fs[0] >> 8 & 0xff;
+    buf[1] = fs[0] & 0xff;
 
     return(true);
 }
 
+/**
+ * @brief : read the ID's and the feature set of the SVM30
+ * @param caps : store the capabilities (all zero if nothing answered)
+ *
+ * @return :
+ *   true if both SGP30 and SHTC1 answered else false
+ */
+bool SVM30::ReadCaps(struct svm_caps *caps) {
+    uint16_t fs[1], id[1];
+
+    memset(caps, 0, sizeof(struct svm_caps));
+
+    if (GetId(SGP30_ADDRESS, caps->serial) && Request<CMD_SGP30_Get_Feature_Set>(fs) == ERR_OK) {
+        caps->feature_set = fs[0];
+        caps->type = fs[0] >> 12 & 0xf;
+        caps->level = fs[0] & 0xff;
+        caps->sgp30 = true;
+        caps->raw = caps->level >= CMD_SGP30_Measure_Raw_Signals.level;
+        caps->inceptive = caps->level >= CMD_SGP30_Get_Inceptive_Baseline.level;
+    }
+
+    if (GetId(SHTC1_ADDRESS, id)) {
+        caps->shtc1_id = id[0];
+        caps->shtc1 = true;
+    }
+
+    if (_SVM30_Debug && caps->sgp30)
+        printf("SGP30 feature set 0x%04X : raw signals %s, inceptive baseline %s\n", caps->feature_set,
+               caps->raw ? "yes" : "no", caps->inceptive ? "yes" : "no");
+
+    return(caps->sgp30 && caps->shtc1);
+}
+
+/**
+ * @brief : return the capabilities read by begin()
+ * @param caps : pointer to store the capabilities
+ *
+ * @return :
+ *   true if both SGP30 and SHTC1 were read else false
+ */
+bool SVM30::GetCaps(struct svm_caps *caps) {
+    svm30_guard g(&_Api);
+
+    memcpy(caps, &_Caps, sizeof(struct svm_caps));
+
+    return(_Caps.sgp30 && _Caps.shtc1);
+}
+
+/**
+ * @brief : a command the SGP30 does not support is not sent
+ * @param c : command descriptor (see svm30cmd.h)
+ *
+ * @return : ERR_UNKNOWNCMD
+ */
+uint8_t SVM30::NotSupported(const svm30_cmd &c) {
+
+    if (_SVM30_Debug) printf("Command 0x%04X needs feature set version 0x%02X, SGP30 has 0x%02X\n",
+                             c.cmd, c.level, _Caps.level);
+
+    return(ERR_UNKNOWNCMD);
+}
+
 /*********************************************************************
  * @brief calculate dew point
  *
@@ -246,24 +574,24 @@ void SVM30::computeHeatIndex(struct svm_values *v) {
  *   true on success else false
  */
 bool SVM30::MeasureTest() {
+    svm30_guard g(&_Api);
 
     bool restart = false;
+    uint16_t result[1];
 
     if (_started) {
        if (! reset(SGP30))  return(false);
        restart = true;
     }
 
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Measure_Test);
-
     // send Request and read from sensor
-    if (RequestFromSVM(2) != ERR_OK) {
+    if (Request<CMD_SGP30_Measure_Test>(result) != ERR_OK) {
         if (_SVM30_Debug) printf("Error during measurement test\n");
         return(false);
     }
 
     // check the return code
-    if (_Receive_BUF[0] != (SGP30_TestOK >> 8 & 0xff) || _Receive_BUF[1] != (SGP30_TestOK & 0xff) ) {
+    if (result[0] != SGP30_TestOK) {
         if (_SVM30_Debug) printf("Error in measurement test return code\n");
         return(false);
     }
@@ -282,15 +610,32 @@ bool SVM30::MeasureTest() {
  *   true on success else false
  */
 bool SVM30::GetBaseLines(uint32_t *baseline) {
-    uint16_t base;
+    svm30_guard g(&_Api);
+    uint16_t base[2];
+
+    // one Get_Baseline returns both
+    if (! ReadBaseLines(base)) return(false);
+
+    *baseline = base[0] << 16 | base[1];
+    return(true);
+}
+
+/**
+ * @brief : get BOTH baselines from the cache, read them when too old
+ *
+ * @param baseline : pointer to baseline to store results
+ * @param maxage : maximum age of the cache (seconds)
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::GetCachedBaseLines(uint32_t *baseline, uint16_t maxage) {
+    svm30_guard g(&_Api);
 
-    // first get TVOC (true))
-    if ( ! GetBaseLine(&base, true)) return(false);
-    *baseline = base << 16;
+    if (_BaseRead == 0 || GetTime() - _BaseRead > (uint64_t) maxage * 1000)
+        return(GetBaseLines(baseline));
 
-    // get CO2 (false)
-    if ( ! GetBaseLine(&base, false)) return(false);
-    *baseline = *baseline | base;
+    *baseline = _BaseCache[0] << 16 | _BaseCache[1];
     return(true);
 }
 
@@ -303,6 +648,27 @@ bool SVM30::GetBaseLines(uint32_t *baseline) {
  *      true get TVOC baseline
  *      false get CO2eq baseline
  *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::GetBaseLine(uint16_t *baseline , bool tvoc) {
+    svm30_guard g(&_Api);
+    uint16_t base[2];
+
+    if (! ReadBaseLines(base)) return(false);
+
+    // copy baseline
+    if (tvoc) *baseline = base[0];
+    else *baseline = base[1];
+
+    return(true);
+}
+
+/**
+ * @brief read both baselines from SGP30 and update the cache
+ *
+ * @param base : store TVOC and CO2eq baseline
+ *
  * source : datasheet
  * The sensor responds with 2 data bytes (MSB first) and 1 CRC byte
  * for each of the two values in the order CO 2 eq and TVOC.
@@ -313,22 +679,66 @@ bool SVM30::GetBaseLines(uint32_t *baseline) {
  * @return :
  *   true on success else false
  */
-bool SVM30::GetBaseLine(uint16_t *baseline , bool tvoc) {
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Get_Baseline);
+bool SVM30::ReadBaseLines(uint16_t (&base)[2]) {
 
     // send Request and read from sensor
-    if (RequestFromSVM(4) != ERR_OK) {
+    if (Request<CMD_SGP30_Get_Baseline>(base) != ERR_OK) {
         if (_SVM30_Debug) printf("Error during reading baseline\n");
         return(false);
     }
 
-    // copy baseline
-    if (tvoc) *baseline = byte_to_uint16(0);
-    else *baseline = byte_to_uint16(2);
+    CacheBaseLines(base);
+    return(true);
+}
+
+/**
+ * @brief write both baselines to SGP30 and update the cache
+ *
+ * @param base : TVOC and CO2eq baseline
+ *
+ * source datasheet:
+ * After a power-up or soft reset, the baseline of the baseline compensation
+ * algorithm can be restored by sending first an “Init_air_quality” command followed
+ * by a “Set_baseline” command with the two baseline values as parameters
+ * in the order as (TVOC, CO 2 eq)
+ *
+ * WARNING: The datasheet is NOT completly correct, as a CRC has to
+ * be added after each baseline.
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::WriteBaseLines(const uint16_t (&base)[2]) {
+
+    if (Command<CMD_SGP30_Set_Baseline>(base) != ERR_OK) {
+        if (_SVM30_Debug) printf("Error during setting baseline\n");
+        return(false);
+    }
+
+    if (_SVM30_Debug) printf(" No responds expected\n");
 
+    CacheBaseLines(base);
     return(true);
 }
 
+/**
+ * @brief remember the baselines as now on the SGP30
+ *
+ * @param base : TVOC and CO2eq baseline
+ */
+void SVM30::CacheBaseLines(const uint16_t (&base)[2]) {
+
+    _BaseCache[0] = base[0];
+    _BaseCache[1] = base[1];
+    _BaseRead = GetTime();
+
+    // remember to restore after hot-unplug (zero during warm-up)
+    if (base[0] != 0 && base[1] != 0) {
+        _Baseline[0] = base[0];
+        _Baseline[1] = base[1];
+    }
+}
+
 /**
  * @brief : set BOTH baselines (TVOC and CO2)
  *
@@ -338,17 +748,16 @@ bool SVM30::GetBaseLine(uint16_t *baseline , bool tvoc) {
  *   true on success else false
  */
 bool SVM30::SetBaseLines(uint32_t baseline) {
-    uint16_t base;
-
-    // first set CO2
-    base = baseline & 0xffff;
-    if ( ! SetBaseLine(base, false)) return(false);
+    svm30_guard g(&_Api);
+    uint16_t base[2] = {(uint16_t) (baseline >> 16), (uint16_t) (baseline & 0xffff)};
 
-    // set TVOC
-    base = (baseline >> 16) & 0xffff;
-    if ( ! SetBaseLine(base, true)) return(false);
+    // see SetBaseLine()
+    if (base[0] == 0x0 || base[1] == 0x0) {
+        if (_SVM30_Debug) printf("Error during setting baseline. Baseline can NOT be zero\n");
+        return(false);
+    }
 
-    return(true);
+    return(WriteBaseLines(base));
 }
 
 /**
@@ -360,21 +769,16 @@ bool SVM30::SetBaseLines(uint32_t baseline) {
  *      true set tvoc baseline
  *      false set CO2eq baseline
  *
- * source datasheet:
- * After a power-up or soft reset, the baseline of the baseline compensation
- * algorithm can be restored by sending first an “Init_air_quality” command followed
- * by a “Set_baseline” command with the two baseline values as parameters
- * in the order as (TVOC, CO 2 eq)
- *
- * WARNING: The datasheet is NOT completly correct, as a CRC has to
- * be added after each baseline.
+ * Set_Baseline always takes both baselines. The other baseline is
+ * taken from the cache, or read first if the cache is older than
+ * BASE_CACHE seconds.
  *
  * @return :
  *   true on success else false
  */
 bool SVM30::SetBaseLine(uint16_t baseline, bool tvoc) {
-    char    data[4];
-    uint16_t base, len;
+    svm30_guard g(&_Api);
+    uint16_t base[2];
 
     /* Setting a baseline of 0x0000 on CO2, will result in CO2
      * being set the same as TVOC. Setting TVOC to 0x0000 is ignored
@@ -386,34 +790,175 @@ bool SVM30::SetBaseLine(uint16_t baseline, bool tvoc) {
          return(false);
      }
 
-    if (tvoc) {
-        data[0] = (baseline >> 8) & 0xff;// MSB  update TVOC
-        data[1] = baseline & 0xff;       // LSB
-        len = 2;
+    // keep the other baseline
+    if (_BaseRead == 0 || GetTime() - _BaseRead > BASE_CACHE * 1000) {
+        if (! ReadBaseLines(base)) return(false);
+    }
+
+    base[0] = _BaseCache[0];
+    base[1] = _BaseCache[1];
+
+    if (tvoc) base[0] = baseline;
+    else base[1] = baseline;
+
+    return(WriteBaseLines(base));
+}
+
+/**
+ * @brief : start the baseline store after begin()
+ * @param running : the IAQ algorithm was already running (attach)
+ */
+void SVM30::StoreStart(bool running) {
+    bool learned;
+
+    _StoreFrom = 0;
+    _Restored = false;
+
+    if (_StoreDir == NULL) return;
+
+    // the serial number is the name of the file
+    if (! _Caps.sgp30) {
+        if (_SVM30_Debug) printf("Baseline store : can not read SGP30 serial number\n");
+        return;
     }
-    else {  // CO2
 
-        // first read current baseline TVOC
-        if ( !GetBaseLine_TVOC(&base)) return(false);
+    // a running algorithm has its own baseline, else restore the stored one
+    if (! running) _Restored = RestoreBaseline();
+    learned = running || _Restored;
+
+    // a new baseline is only stored after it has been learned
+    _StoreFrom = time(NULL) + (learned ? 0 : BASE_LEARN);
+    _StoreNext = time(NULL) + (learned ? BASE_INTERVAL : BASE_LEARN);
+}
+
+/**
+ * @brief : file name of the baseline store
+ * @param path : store the name
+ * @param len : size of path
+ */
+void SVM30::StorePath(char *path, size_t len) {
+    snprintf(path, len, "%s/sgp30-%04X%04X%04X.base", _StoreDir, _Caps.serial[0], _Caps.serial[1], _Caps.serial[2]);
+}
+
+/**
+ * @brief : restore the baseline from the store
+ *
+ * The file has one line : serial number, time stored (seconds since
+ * epoch), TVOC and CO2eq baseline (hex).
+ *
+ * @return :
+ *   true if restored else false
+ */
+bool SVM30::RestoreBaseline() {
+    char path[PATH_MAX], serial[16], want[16];
+    unsigned int tvoc, co2;
+    long stored;
+    time_t now = time(NULL);
+    FILE *fp;
+    int n;
+
+    StorePath(path, sizeof(path));
+
+    // nothing stored yet
+    fp = fopen(path, "r");
+    if (fp == NULL) return(false);
+
+    n = fscanf(fp, "%15s %ld %x %x", serial, &stored, &tvoc, &co2);
+    fclose(fp);
+
+    snprintf(want, sizeof(want), "%04X%04X%04X", _Caps.serial[0], _Caps.serial[1], _Caps.serial[2]);
 
-        data[0] = (base >> 8) & 0xff;    // MSB keep TVOC
-        data[1] = base & 0xff;           // LSB
-        data[2] = (baseline >> 8) & 0xff;// MSB update Co2
-        data[3] = baseline & 0xff;       // LSB
-        len = 4;
+    if (n != 4 || strcmp(serial, want) != 0 || tvoc == 0 || co2 == 0 || tvoc > 0xffff || co2 > 0xffff) {
+        if (_SVM30_Debug) printf("Baseline store : invalid %s\n", path);
+        return(false);
     }
 
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Set_Baseline, data, len);
+    // datasheet : a baseline older than 7 days is not valid
+    if (stored > now || now - stored > BASE_MAXAGE) {
+        if (_SVM30_Debug) printf("Baseline store : %s is too old\n", path);
+        return(false);
+    }
 
-    // send Request to sensor
-    if (SendToSVM() != ERR_OK) {
-        if (_SVM30_Debug) printf("Error during setting baseline\n");
+    if (! SetBaseLines(tvoc << 16 | co2)) return(false);
+
+    if (_SVM30_Debug) printf("Baseline store : restored TVOC 0x%04X CO2eq 0x%04X\n", tvoc, co2);
+
+    return(true);
+}
+
+/**
+ * @brief : read the baseline from the SGP30 and store it
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::SaveBaseline() {
+    svm30_guard g(&_Api);
+    char path[PATH_MAX], tmp[PATH_MAX + 4], line[64];
+    uint16_t base[2];
+    int fd, len;
+    bool ok;
+
+    if (_StoreDir == NULL) return(false);
+
+    // zero during warm-up
+    if (! ReadBaseLines(base) || base[0] == 0 || base[1] == 0) {
+        if (_SVM30_Debug) printf("Baseline store : no baseline to store\n");
         return(false);
     }
-    if (_SVM30_Debug) printf(" No responds expected\n");
+
+    StorePath(path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    len = snprintf(line, sizeof(line), "%04X%04X%04X %ld %04X %04X\n",
+                   _Caps.serial[0], _Caps.serial[1], _Caps.serial[2], (long) time(NULL), base[0], base[1]);
+
+    // write a new file and replace the old one : never a partial file
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ok = fd >= 0;
+
+    if (ok && (write(fd, line, len) != len || fsync(fd) != 0)) ok = false;
+    if (fd >= 0 && ::close(fd) != 0) ok = false;
+    if (ok && rename(tmp, path) != 0) ok = false;
+
+    if (! ok) {
+        if (_SVM30_Debug) printf("Baseline store : can not write %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return(false);
+    }
+
+    // the rename itself must survive a power loss
+    fd = open(_StoreDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+
+    if (_SVM30_Debug) printf("Baseline store : stored TVOC 0x%04X CO2eq 0x%04X\n", base[0], base[1]);
+
     return(true);
 }
 
+/**
+ * @brief : store the baseline when a checkpoint is due
+ * @param final : store now if the baseline has been learned (close())
+ */
+void SVM30::Checkpoint(bool final) {
+    svm30_guard g(&_Api);
+    time_t now = time(NULL);
+
+    if (_StoreFrom == 0 || now < _StoreFrom) return;
+    if (! final && now < _StoreNext) return;
+
+    // the SGP30 is measuring : try again on the next call. The final
+    // store goes ahead, a command while measuring is retried
+    if (_Async == ASYNC_BUSY && ! final) return;
+
+    _StoreNext = now + BASE_INTERVAL;
+
+    SaveBaseline();
+}
+
 /**
  * @brief : Set temperature.
  *
@@ -433,26 +978,24 @@ void SVM30::SetTempCelsius(bool act) {
  *   true on success else false
  */
 bool SVM30::SetHumidity(float humidity) {
-    char    data[2];
+    svm30_guard g(&_Api);
 
-    if (humidity > 256000 || humidity < 0) {
+    if (humidity >= 256 || humidity < 0) {
         if (_SVM30_Debug) printf("Invalid humidity\n");
         return (false);
     }
 
     // convert to 8.8 fixed point
-    uint16_t ConvHum = ConvAbsolute(humidity);
-
-    data[0] = (ConvHum >> 8) & 0xff; //MSB
-    data[1] = ConvHum & 0xff;        //LSB
-
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Set_Humidity, data, 2);
+    uint16_t data[1] = {ConvAbsolute(humidity)};
 
     // send Request to sensor
-    if (SendToSVM() != ERR_OK) {
+    if (Command<CMD_SGP30_Set_Humidity>(data) != ERR_OK) {
         if (_SVM30_Debug) printf("Error during setting humidity\n");
         return(false);
     }
+
+    HumiditySent(data[0]);
+
     if (_SVM30_Debug) printf("No responds expected\n");
     return(true);
 }
@@ -491,16 +1034,18 @@ void SVM30::calc_dewpoint(struct svm_values *v) {
  *   true on success else false
  */
 bool SVM30::GetId(uint8_t device, uint16_t *buf) {
-    uint8_t i = 0, j = 0, len;
+    svm30_guard g(&_Api);
+    uint8_t ret;
 
     if (device == SGP30_ADDRESS) {
 
         /* The get serial ID command returns 3 words (6 bytes) and
          * every word (2 bytes) is followed by an 8-bit CRC checksum.
          * Together the 3 words constitute a unique serial ID with a length of 48 bits.*/
+        uint16_t id[3];
 
-        len = 6;
-        PrepSendBuffer(SGP30_ADDRESS, SGP30_Read_ID);
+        ret = Request<CMD_SGP30_Read_ID>(id);
+        if (ret == ERR_OK) memcpy(buf, id, sizeof(id));
     }
 
     else if (device == SHTC1_ADDRESS) {
@@ -509,279 +1054,1213 @@ bool SVM30::GetId(uint8_t device, uint16_t *buf) {
         * the command, the master can send an I2C read header and
         * the SHTC1 will submit the 16-bit ID followed by 8 bits of CRC.
         * REMARK : only bit 5:0 are valid for SHTC1 ID (source: datasheet)*/
+        uint16_t id[1];
 
-        len = 2;
-        PrepSendBuffer(SHTC1_ADDRESS, SHTC1_Read_ID);
+        ret = Request<CMD_SHTC1_Read_ID>(id);
+        if (ret == ERR_OK) buf[0] = id[0];
     }
 
     else
         return(false);
 
-    // send Request and read from sensor
-    if (RequestFromSVM(len)){
+    if (ret != ERR_OK){
         if (_SVM30_Debug) printf("Error during get ID\n");
         return(false);
     }
 
-    // copy received ID number
-    for (i = 0; i < len; i += 2)  buf[j++] = byte_to_uint16(i);
+    return(true);
+}
+
+/**
+ * @brief : check if SVM30 sensors are available (read ID)
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::probe() {
+    svm30_guard g(&_Api);
+    uint16_t buf[3];        // SGP30 has 3 words, SHTC1 has 1 word
+
+    if (GetId(SGP30_ADDRESS, buf) != true){
+         if (_SVM30_Debug) printf("Error during probe SGP30 at address 0x%x\n", SGP30_ADDRESS );
+         return(false);
+    }
+
+    if (GetId(SHTC1_ADDRESS, buf) != true) {
+        if (_SVM30_Debug) printf("Error during probe SHTC1 at address 0x%x\n", SHTC1_ADDRESS);
+        return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief : Trigger a read on the SGP30
+ *
+ * The on-chip baseline compensation algorithm has been optimized
+ * for 1HZ sampling rate. The sensor shows best performance when
+ * used with this sampling rate.
+ *
+ * Sample rate to be implemented in the user program (see examples)
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::TriggerSGP30() {
+    svm30_guard g(&_Api);
+    uint16_t aq[2];
+
+    if (! Resume()) return(false);
+
+    return(MeasureAirQuality(aq) == ERR_OK);
+}
+
+/**
+ * @brief : Measure air quality on the SGP30
+ *
+ * @param aq : store CO2 equivalent and TVOC
+ *
+ * @return :
+ *   ERR_OK on success else error code
+ */
+uint8_t SVM30::MeasureAirQuality(uint16_t (&aq)[2]) {
+    uint8_t ret;
+
+    // Start SGP30 measurement if not started already?
+    if (! StartSGP30()) return(ERR_CMDSTATE);
+
+    SendHumidity();
+
+    // get TVOC and CO2 equivalent data
+    // send Request and read from sensor
+    ret = Request<CMD_SGP30_Measure_Air_Quality>(aq);
+    if (ret != ERR_OK && _SVM30_Debug) printf("Error during reading TVOC and CO2\n");
+
+    return(ret);
+}
+
+/**
+ * @brief : get Inceptivebaseline  (impact TVOC only)
+ *
+ * See datasheet May 2020 SGP30
+ *
+ * !!! REQUIRES LEVEL 34 FEATURE SET !!!
+ * @param *baseline
+ *   Store the baseline
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::GetInceptiveBaseLine_TVOC(uint16_t *baseline) {
+    svm30_guard g(&_Api);
+    uint16_t base[1];
+
+    // send Request and read from sensor
+    if (Request<CMD_SGP30_Get_Inceptive_Baseline>(base) != ERR_OK) {
+        if (_SVM30_Debug) printf("Error during reading Inceptivebaseline\n");
+        return(false);
+    }
+
+    // copy baseline
+    *baseline = base[0];
+
+    return(true);
+}
+
+/**
+ * @brief : set Inceptivebaseline  (impact TVOC only)
+ *
+ * See datasheet May 2020 SGP30
+ *
+ * !!! REQUIRES LEVEL 34 FEATURE SET !!!
+ * @param baseline
+ *      Store the baseline to set (previous obtained with GetInceptiveBaseLine_TVOC
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::SetInceptiveBaseLine_TVOC(uint16_t baseline) {
+    svm30_guard g(&_Api);
+    uint16_t data[1] = {baseline};
+
+    if (baseline == 0x0) {
+         if (_SVM30_Debug) printf("Error during setting Inceptivebaseline. Baseline can NOT be zero\n");
+         return(false);
+    }
+
+    // send Request to sensor
+    if (Command<CMD_SGP30_Set_Inceptive_Baseline>(data) != ERR_OK) {
+        if (_SVM30_Debug) printf("Error during setting Inceptivebaseline\n");
+        return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief : read all measurement values from the sensor and store in structure
+ * @param v: pointer to structure to store
+ * 
+ * @param raw: if true it will also read the raw values from the SGP30 (update 1.2)
+ *
+ * Raw is ignored on an SGP30 that does not support reading raw (see
+ * Supported()), false skips the raw values on any SGP30.
+ *
+ * A field that fails is marked in its quality (q_aq, q_raw, q_th), the
+ * other fields are still measured.
+ *
+ * @return :
+ *   true if at least one field was measured else false
+ */
+bool SVM30::GetValues(struct svm_values *v, bool raw) {
+    svm30_guard g(&_Api);
+    uint8_t done = 0;
+
+    memset(v,0x0,sizeof(struct svm_values));
+
+    // nothing measured yet
+    v->q_aq = v->q_raw = v->q_th = SVM_Q_FAILED;
+
+    // SVM30 dropped off the bus : wait for it to return
+    if (! Resume()) return(false);
+
+    // not measured by an SGP30 before feature set 0x20
+    if (! Supported(CMD_SGP30_Measure_Raw_Signals)) raw = false;
+
+    if (_Pipelined) {
+        done = Pipeline(v, raw);
+    }
+    else {
+        /** data from SGP30  */
+        if (GetAirQuality(v)) done |= SVM_AQ;
+
+        // get raw H2 signal and Ethanol signal
+        if (raw && GetRawSignals(v)) done |= SVM_RAW;
+
+        /** data from SHTC1 */
+        if (GetTempHum(v)) done |= SVM_TH;
+    }
+
+    return(done != 0);
+}
+
+/**
+ * @brief : store SGP30 air quality and check it
+ * @param v : pointer to structure to update
+ * @param aq : CO2 equivalent and TVOC
+ */
+void SVM30::StoreAirQuality(struct svm_values *v, const uint16_t (&aq)[2]) {
+
+    v->CO2eq = aq[0];
+    v->TVOC  = aq[1];
+    v->t_aq = GetTime();
+    v->q_aq = 0;
+
+    if (_InitTime > 0 && v->t_aq < _InitTime + WARMUP_TIME) v->q_aq |= SVM_Q_WARMUP;
+
+    // datasheet : 400 - 60000 ppm CO2eq, 0 - 60000 ppb TVOC
+    if (v->CO2eq < 400 || v->CO2eq > 60000 || v->TVOC > 60000) v->q_aq |= SVM_Q_RANGE;
+}
+
+/**
+ * @brief : store SGP30 raw signals
+ * @param v : pointer to structure to update
+ * @param rs : H2 and Ethanol signal
+ */
+void SVM30::StoreRawSignals(struct svm_values *v, const uint16_t (&rs)[2]) {
+
+    v->H2_signal = rs[0];
+    v->Ethanol_signal  = rs[1];
+    v->t_raw = GetTime();
+    v->q_raw = 0;
+}
+
+/**
+ * @brief : mark a field that could not be measured
+ * @param v : pointer to structure to update
+ * @param field : SVM_AQ, SVM_RAW or SVM_TH
+ * @param ret : error code of the measurement
+ *
+ * The value of an earlier measurement is kept (SVM_Q_STALE).
+ */
+void SVM30::StoreFailed(struct svm_values *v, uint8_t field, uint8_t ret) {
+    uint8_t *q;
+    uint64_t t;
+
+    if (field == SVM_AQ) { q = &v->q_aq; t = v->t_aq; }
+    else if (field == SVM_RAW) { q = &v->q_raw; t = v->t_raw; }
+    else { q = &v->q_th; t = v->t_th; }
+
+    // keep what was known about the earlier value
+    if (t > 0) *q = (*q & (SVM_Q_WARMUP | SVM_Q_RANGE)) | SVM_Q_STALE;
+    else *q = 0;
+
+    *q |= SVM_Q_FAILED;
+    if (ret == ERR_PROTOCOL) *q |= SVM_Q_CRC;
+}
+
+/**
+ * @brief : store SHTC1 values and calculate the derived values
+ * @param v : pointer to structure to update
+ * @param th : raw temperature and humidity
+ */
+void SVM30::StoreTempHum(struct svm_values *v, const uint16_t (&th)[2]) {
+
+    // get the raw values from the SHTC
+    v->r_temperature = th[0];
+    v->r_humidity  = th[1];
+
+    // convert to useable temperature and humidity
+    shtc1_conv(&v->temperature, &v->humidity, v->r_temperature, v->r_humidity);
+
+    // calculate absolute humidity
+    calc_absolute_humidity(v);
+
+    // calculate heat Index
+    computeHeatIndex(v);
+
+    // calculate dew_point
+    calc_dewpoint(v);
+
+    v->t_th = GetTime();
+    v->q_th = 0;
+
+    // datasheet : -30 - 100 C, checked on the raw value (independent of F / C)
+    if (v->r_temperature < 0x15F1 || v->r_temperature > 0xD41D) v->q_th |= SVM_Q_RANGE;
+
+    // sent before the next air quality measurement (if needed)
+    if (_HumComp && v->q_th == 0 && v->absolute_hum > 0) _HumTarget = ConvAbsolute(v->absolute_hum);
+}
+
+/**
+ * @brief : measure CO2eq and TVOC
+ * @param v: pointer to structure to update
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::GetAirQuality(struct svm_values *v) {
+    svm30_guard g(&_Api);
+    uint16_t aq[2];
+    uint8_t ret;
+
+    if (! Resume()) ret = ERR_NACK;
+    else ret = MeasureAirQuality(aq);
+
+    if (ret != ERR_OK) {
+        StoreFailed(v, SVM_AQ, ret);
+        return(false);
+    }
+
+    StoreAirQuality(v, aq);
+
+    return(true);
+}
+
+/**
+ * @brief : measure H2 and Ethanol signals
+ * @param v: pointer to structure to update
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::GetRawSignals(struct svm_values *v) {
+    svm30_guard g(&_Api);
+    uint16_t rs[2];
+    uint8_t ret;
+
+    if (! Resume()) ret = ERR_NACK;
+    else if (! StartSGP30()) ret = ERR_CMDSTATE;
+    else ret = Request<CMD_SGP30_Measure_Raw_Signals>(rs);
+
+    if (ret != ERR_OK) {
+        if (_SVM30_Debug) printf("Error during reading Raw signals\n");
+        StoreFailed(v, SVM_RAW, ret);
+        return(false);
+    }
+
+    StoreRawSignals(v, rs);
+
+    return(true);
+}
+
+/**
+ * @brief : measure temperature and humidity
+ * @param v: pointer to structure to update
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::GetTempHum(struct svm_values *v) {
+    svm30_guard g(&_Api);
+    uint16_t th[2];
+    uint8_t ret;
+
+    if (! Resume()) ret = ERR_NACK;
+    else ret = Request<CMD_SHTC1_Read_Temp_First>(th);
+
+    if (ret != ERR_OK) {
+        if (_SVM30_Debug) printf("Error during reading SHTC1\n");
+        StoreFailed(v, SVM_TH, ret);
+        return(false);
+    }
+
+    StoreTempHum(v, th);
+
+    return(true);
+}
+
+/**
+ * @brief : set the intervals for Sample()
+ * @param s : intervals in mS (0 = do not measure)
+ */
+void SVM30::SetSchedule(const struct svm_schedule *s) {
+    svm30_guard g(&_Api);
+    _Schedule = *s;
+
+    // all due at first Sample()
+    memset(_Due, 0, sizeof(_Due));
+}
+
+/**
+ * @brief : check whether a signal is due and plan the next slot
+ * @param i : index in _Due
+ * @param interval : interval of the signal (mS)
+ * @param now : current time (mS)
+ *
+ * @return : true if due
+ */
+bool SVM30::Due(uint8_t i, uint32_t interval, uint64_t now) {
+
+    if (interval == 0 || now < _Due[i]) return(false);
+
+    // next slot, skip the slots that were missed
+    _Due[i] += interval;
+    if (_Due[i] <= now) _Due[i] = now + interval;
+
+    return(true);
+}
+
+/**
+ * @brief : return the signals that are due and plan their next slot
+ * @param now : time (mS, see GetTime())
+ *
+ * @return : SVM_AQ, SVM_RAW and/or SVM_TH
+ */
+uint8_t SVM30::GetDue(uint64_t now) {
+    svm30_guard g(&_Api);
+    uint8_t due = 0;
+
+    if (Due(0, _Schedule.aq, now)) due |= SVM_AQ;
+    if (Due(1, _Schedule.raw, now) && Supported(CMD_SGP30_Measure_Raw_Signals)) due |= SVM_RAW;
+    if (Due(2, _Schedule.th, now)) due |= SVM_TH;
+
+    return(due);
+}
+
+/**
+ * @brief : measure the signals that are due
+ * @param v: pointer to structure to update
+ * @param next : if not NULL, store mS until the next signal is due
+ *
+ * @return : SVM_AQ, SVM_RAW and/or SVM_TH for the updated fields
+ */
+uint8_t SVM30::Sample(struct svm_values *v, uint32_t *next) {
+    return(SampleAt(v, next, GetTime(), NULL));
+}
+
+/**
+ * @brief : measure the signals that are due at a given time
+ * @param v: pointer to structure to update
+ * @param next : if not NULL, store mS until the next signal is due
+ * @param now : time (mS) to plan with
+ * @param due : if not NULL, store the fields that were due
+ *
+ * @return : SVM_AQ, SVM_RAW and/or SVM_TH for the updated fields
+ */
+uint8_t SVM30::SampleAt(struct svm_values *v, uint32_t *next, uint64_t now, uint8_t *due) {
+    svm30_guard g(&_Api);
+    uint32_t interval[3] = {_Schedule.aq, _Schedule.raw, _Schedule.th};
+    uint64_t first = 0;
+    uint8_t done = 0, i;
+    bool d_aq, d_raw, d_th;
+
+    i = GetDue(now);
+    d_aq  = i & SVM_AQ;
+    d_raw = i & SVM_RAW;
+    d_th  = i & SVM_TH;
+
+    if (due) *due = i;
+
+    if (d_aq || d_raw || d_th) {
+
+        // air quality and temperature due together : overlap them
+        if (_Pipelined && d_aq && d_th && Resume()) {
+            done = Pipeline(v, d_raw);
+        }
+        else {
+            // each field on its own, a failure is marked in its quality
+            if (d_aq && GetAirQuality(v)) done |= SVM_AQ;
+            if (d_raw && GetRawSignals(v)) done |= SVM_RAW;
+            if (d_th && GetTempHum(v)) done |= SVM_TH;
+        }
+    }
+
+    if (next) {
+        now = GetTime();
+
+        for (i = 0; i < 3; i++) {
+            if (interval[i] == 0) continue;
+            if (first == 0 || _Due[i] < first) first = _Due[i];
+        }
+
+        *next = first > now ? first - now : 0;
+    }
+
+    return(done);
+}
+
+/**
+ * @brief : return the time in mS as used for the time stamps
+ */
+uint64_t SVM30::GetTime() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/**
+ * @brief : get monotonic time in uS
+ */
+static uint64_t mono_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/**
+ * @brief : start a thread that calls Sample() on a fixed period
+ * @param period : period in mS
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30::StartSampler(uint32_t period) {
+    sigset_t all, old;
+    int ret;
+
+    if (_SamplerRun || period == 0) return(false);
+
+    {
+        svm30_guard g(&_Api);
+
+        // default : air quality only, at the sampler period
+        if (_Schedule.aq == 0 && _Schedule.raw == 0 && _Schedule.th == 0)
+            _Schedule.aq = period;
+
+        memset(_Due, 0, sizeof(_Due));
+    }
+
+    _Period = period;
+    _SamplerStop = false;
+    _SampleDone = _SampleDue = 0;
+    _Agg.count = 0;
+    memset(&_SamplerStats, 0, sizeof(_SamplerStats));
+
+    // signals are handled by the calling thread, not by the sampler
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    ret = pthread_create(&_Sampler, NULL, SamplerThread, this);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        if (_SVM30_Debug) printf("Can not start sampler thread: %s\n", strerror(ret));
+        return(false);
+    }
+
+    _SamplerRun = true;
+    return(true);
+}
+
+/**
+ * @brief : stop the sampler thread (waits for the current tick)
+ */
+void SVM30::StopSampler() {
+
+    if (! _SamplerRun) return;
+
+    pthread_mutex_lock(&_SampleLock);
+    _SamplerStop = true;
+    pthread_cond_broadcast(&_SampleCond);
+    pthread_mutex_unlock(&_SampleLock);
+
+    pthread_join(_Sampler, NULL);
+    _SamplerRun = false;
+}
+
+/**
+ * @brief : wait for the sampler to measure a field
+ * @param v: store the latest values
+ * @param fields : SVM_AQ, SVM_RAW and/or SVM_TH to wait for
+ * @param timeout : maximum wait in mS
+ *
+ * @return : the fields updated since the previous call, 0 on
+ * timeout, failure or when the sampler is not running
+ */
+uint8_t SVM30::WaitSample(struct svm_values *v, uint8_t fields, uint32_t timeout, struct svm_aggregate *agg) {
+    struct timespec ts;
+    uint64_t until;
+    uint8_t done = 0;
+
+    if (! _SamplerRun) return(0);
+
+    until = mono_us() + (uint64_t) timeout * 1000;
+    ts.tv_sec = until / 1000000;
+    ts.tv_nsec = (until % 1000000) * 1000;
+
+    pthread_mutex_lock(&_SampleLock);
+
+    while (! (_SampleDue & fields) && ! _SamplerStop) {
+        if (pthread_cond_timedwait(&_SampleCond, &_SampleLock, &ts) == ETIMEDOUT) break;
+    }
+
+    if (_SampleDue & fields) {
+        *v = _Latest;
+        done = _SampleDone;
+        _SampleDone = _SampleDue = 0;
+
+        if (agg) Reduce(agg);
+        _Agg.count = 0;
+    }
+
+    pthread_mutex_unlock(&_SampleLock);
+
+    return(done);
+}
+
+/**
+ * @brief : add a CO2eq / TVOC reading to the aggregate
+ * @param v : latest values
+ *
+ * Called with _SampleLock held.
+ */
+void SVM30::Aggregate(const struct svm_values *v) {
+    uint16_t val[2] = {v->CO2eq, v->TVOC};
+    struct svm_stat *st[2] = {&_Agg.CO2eq, &_Agg.TVOC};
+
+    for (uint8_t i = 0; i < 2; i++) {
+
+        if (_Agg.count == 0) {
+            st[i]->min = st[i]->max = val[i];
+            _AggSum[i] = 0;
+        }
+        else {
+            if (val[i] < st[i]->min) st[i]->min = val[i];
+            if (val[i] > st[i]->max) st[i]->max = val[i];
+        }
+
+        st[i]->last = val[i];
+        _AggSum[i] += val[i];
+        _AggBuf[i][_Agg.count % AGG_MAX] = val[i];
+    }
+
+    _Agg.count++;
+}
+
+/**
+ * @brief : return the statistics of the CO2eq / TVOC readings since the
+ * previous call and start a new aggregate
+ * @param agg : store the result
+ */
+void SVM30::GetAggregate(struct svm_aggregate *agg) {
+    pthread_mutex_lock(&_SampleLock);
+    Reduce(agg);
+    _Agg.count = 0;
+    pthread_mutex_unlock(&_SampleLock);
+}
+
+/**
+ * @brief : compare for qsort()
+ */
+static int cmp_u16(const void *a, const void *b) {
+    return(*(const uint16_t *) a - *(const uint16_t *) b);
+}
+
+/**
+ * @brief : calculate mean and median of the aggregate
+ * @param agg : store the result
+ *
+ * Called with _SampleLock held.
+ */
+void SVM30::Reduce(struct svm_aggregate *agg) {
+    uint16_t sorted[AGG_MAX];
+    uint32_t n = _Agg.count < AGG_MAX ? _Agg.count : AGG_MAX;
+    struct svm_stat *st[2] = {&_Agg.CO2eq, &_Agg.TVOC};
+
+    for (uint8_t i = 0; i < 2 && n > 0; i++) {
+        st[i]->mean = (float) _AggSum[i] / _Agg.count;
+
+        memcpy(sorted, _AggBuf[i], n * sizeof(uint16_t));
+        qsort(sorted, n, sizeof(uint16_t), cmp_u16);
+        st[i]->median = n & 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    }
+
+    *agg = _Agg;
+}
+
+/**
+ * @brief : return the sampler thread statistics
+ */
+void SVM30::GetSamplerStats(struct svm_sampler *s) {
+    pthread_mutex_lock(&_SampleLock);
+    *s = _SamplerStats;
+    pthread_mutex_unlock(&_SampleLock);
+}
+
+/**
+ * @brief : sampler thread entry
+ */
+void *SVM30::SamplerThread(void *arg) {
+    ((SVM30 *) arg)->Sampler();
+    return(NULL);
+}
+
+/**
+ * @brief : call Sample() at absolute deadlines until stopped
+ *
+ * The deadlines are a multiple of the period from the start, so the
+ * time a tick takes does not move the next one.
+ */
+void SVM30::Sampler() {
+    struct svm_values v;
+    struct timespec ts;
+    uint64_t deadline, period = (uint64_t) _Period * 1000, now, prev = 0, late;
+    uint8_t done, due;
+    bool stop;
+
+    pthread_mutex_lock(&_SampleLock);
+    v = _Latest;
+    pthread_mutex_unlock(&_SampleLock);
+
+    deadline = mono_us();
+
+    while (1) {
+
+        now = mono_us();
+        late = now > deadline ? now - deadline : 0;
+
+        // measure what is due at this deadline
+        done = SampleAt(&v, NULL, deadline / 1000, &due);
+
+        // store the baseline every BASE_INTERVAL, after the measurement
+        Checkpoint();
+
+        pthread_mutex_lock(&_SampleLock);
+
+        _Latest = v;
+        _SampleDone |= done;
+        _SampleDue |= due;
+
+        if (done & SVM_AQ) Aggregate(&v);
+
+        _SamplerStats.ticks++;
+        _SamplerStats.late_sum += late;
+        if (late > _SamplerStats.late_max) _SamplerStats.late_max = late;
+
+        if (prev > 0) {
+            if (_SamplerStats.period_min == 0 || now - prev < _SamplerStats.period_min)
+                _SamplerStats.period_min = now - prev;
+            if (now - prev > _SamplerStats.period_max)
+                _SamplerStats.period_max = now - prev;
+        }
+        prev = now;
+
+        // next deadline, skip the ones that passed during this tick
+        deadline += period;
+        now = mono_us();
+
+        while (deadline <= now) {
+            deadline += period;
+            _SamplerStats.missed++;
+        }
+
+        pthread_cond_broadcast(&_SampleCond);
+
+        // sleep until the deadline (_SampleCond uses CLOCK_MONOTONIC),
+        // StopSampler() wakes up the sampler immediately
+        ts.tv_sec = deadline / 1000000;
+        ts.tv_nsec = (deadline % 1000000) * 1000;
+
+        while (! _SamplerStop) {
+            if (pthread_cond_timedwait(&_SampleCond, &_SampleLock, &ts) == ETIMEDOUT) break;
+        }
+
+        stop = _SamplerStop;
+        pthread_mutex_unlock(&_SampleLock);
+
+        if (stop) break;
+    }
+}
+
+/*****************************************************************
+ * asynchronous measurement
+ ****************************************************************/
+
+/**
+ * @brief : start a measurement without waiting for the result
+ * @param fields : SVM_AQ, SVM_RAW and/or SVM_TH to measure
+ *
+ * @return :
+ *   true on success else false (busy or absent)
+ */
+bool SVM30::StartMeasurement(uint8_t fields) {
+    svm30_guard g(&_Api);
+
+    if (_Async == ASYNC_BUSY || _SamplerRun) return(false);
+    if (! Supported(CMD_SGP30_Measure_Raw_Signals)) fields &= ~SVM_RAW;
+    if ((fields & (SVM_AQ | SVM_RAW | SVM_TH)) == 0) return(false);
+
+    // SVM30 dropped off the bus : wait for it to return
+    if (! Resume()) return(false);
+
+    // the SGP30 measurement must have been started
+    if ((fields & (SVM_AQ | SVM_RAW)) && ! StartSGP30()) return(false);
+
+    // one command at a time per device, in this order
+    _Steps = 0;
+    if (fields & SVM_TH) AddStep(CMD_SHTC1_Read_Temp_First, SVM_TH);
+    if ((fields & SVM_AQ) && HumidityDue()) AddStep(CMD_SGP30_Set_Humidity, 0, _HumTarget);
+    if (fields & SVM_AQ) AddStep(CMD_SGP30_Measure_Air_Quality, SVM_AQ);
+    if (fields & SVM_RAW) AddStep(CMD_SGP30_Measure_Raw_Signals, SVM_RAW);
+
+    _Async = ASYNC_BUSY;
+    _AsyncClock = mono_us();
+
+    // send the first commands
+    Poll();
+
+    return(true);
+}
+
+/**
+ * @brief : add a command to the asynchronous measurement
+ * @param c : command descriptor (see svm30cmd.h)
+ * @param field : SVM_AQ, SVM_RAW or SVM_TH (0 = command without response)
+ * @param param : parameter word (if the command has one)
+ */
+void SVM30::AddStep(const svm30_cmd &c, uint8_t field, uint16_t param) {
+    struct svm_step *s = &_Step[_Steps++];
+
+    memset(s, 0, sizeof(struct svm_step));
+    s->cmd = &c;
+    s->field = field;
+    s->param[0] = param;
+    s->state = STEP_WAIT;
+}
+
+/**
+ * @brief : return a file descriptor that is readable when Poll()
+ * has work to do
+ *
+ * @return : descriptor or -1 on error
+ */
+int SVM30::ReadyFd() {
+    svm30_guard g(&_Api);
+
+    if (_TimerFd < 0) {
+        _TimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        if (_TimerFd < 0 && _SVM30_Debug) printf("Can not create timer: %s\n", strerror(errno));
+
+        // a measurement is already waiting
+        if (_Async == ASYNC_BUSY) ArmTimer(mono_us());
+    }
+
+    return(_TimerFd);
+}
+
+/**
+ * @brief : set the time ReadyFd() becomes readable
+ * @param due : time (uS, CLOCK_MONOTONIC), 0 = disarm
+ */
+void SVM30::ArmTimer(uint64_t due) {
+    struct itimerspec its;
+
+    if (_TimerFd < 0) return;
+
+    memset(&its, 0, sizeof(its));
+
+    // a zero it_value disarms, a due time in the past fires at once
+    if (due > 0) {
+        its.it_value.tv_sec = due / 1000000;
+        its.it_value.tv_nsec = (due % 1000000) * 1000;
+    }
+
+    timerfd_settime(_TimerFd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * @brief : handle the measurement started with StartMeasurement()
+ *
+ * @return : ASYNC_IDLE, ASYNC_BUSY, ASYNC_DONE or ASYNC_FAILED
+ */
+uint8_t SVM30::Poll() {
+    svm30_guard g(&_Api);
+    uint64_t now, next = 0, expired;
+    uint8_t i, j, ok = 0, end = 0;
+    bool blocked;
+
+    // clear the readable state of the timer
+    if (_TimerFd >= 0 && read(_TimerFd, &expired, sizeof(expired)) < 0) expired = 0;
+
+    if (_Async != ASYNC_BUSY) return(_Async);
+
+    // a transport with its own clock (simulator) sees the time passed
+    now = mono_us();
+    if (now > _AsyncClock) _I2C->Elapsed(now - _AsyncClock);
+    _AsyncClock = now;
+
+    for (i = 0; i < _Steps; i++) {
+        struct svm_step *s = &_Step[i];
+
+        // a command waits for the earlier commands of the same device
+        blocked = false;
+        for (j = 0; j < i; j++) {
+            if (_Step[j].cmd->address == s->cmd->address && _Step[j].state < STEP_OK) blocked = true;
+        }
+
+        if (! blocked && s->state < STEP_OK && s->due <= now) {
+            Step(s, now);
+            now = mono_us();
+        }
+
+        // only a measured field makes the measurement a success
+        if (s->state >= STEP_OK) {
+            end++;
+            if (s->state == STEP_OK && s->field) ok++;
+        }
+        else if (! blocked && (next == 0 || s->due < next)) next = s->due;
+    }
+
+    if (end < _Steps) {
+        ArmTimer(next > 0 ? next : now);
+        return(_Async);
+    }
+
+    ArmTimer(0);
+    _Async = ok > 0 ? ASYNC_DONE : ASYNC_FAILED;
+
+    return(_Async);
+}
+
+/**
+ * @brief : send a command or read its response
+ * @param s : command to handle
+ * @param now : current time (uS)
+ */
+void SVM30::Step(struct svm_step *s, uint64_t now) {
+    const svm30_cmd &c = *s->cmd;
+    svm30_frame<2> frame;
+    useconds_t backoff = 0;
+    uint8_t ret;
+
+    // a command without response is done once it had its time
+    if (s->state == STEP_SENT && c.resp == 0) {
+        s->state = STEP_OK;
+        return;
+    }
+
+    Claim();
+
+    if (s->state == STEP_WAIT) {
+        PrepSendBuffer(c, s->param);
+        ret = SendToSVM(false);
+    }
+    else {
+        SetCommand(c);
+        ret = ReadFromSVM(frame.raw, sizeof(frame.raw));
+    }
+
+    Release();
 
-    return(true);
-}
+    if (ret == ERR_OK && s->state == STEP_WAIT) {
+        s->state = STEP_SENT;
+        s->sent = now;
 
-/**
- * @brief : check if SVM30 sensors are available (read ID)
- *
- * @return :
- *   true on success else false
- */
-bool SVM30::probe() {
-    uint16_t buf[3];        // SGP30 has 3 words, SHTC1 has 1 word
+        // when polling, try to read after the typical time. Without
+        // response there is nothing to poll : wait the maximum time
+        if (_Polling && c.resp == 0 && c.max < c.wait) s->due = now + c.max;
+        else if (_Polling && c.typ < c.wait) s->due = now + c.typ;
+        else s->due = now + c.wait;
+        return;
+    }
 
-    if (GetId(SGP30_ADDRESS, buf) != true){
-         if (_SVM30_Debug) printf("Error during probe SGP30 at address 0x%x\n", SGP30_ADDRESS );
-         return(false);
+    // not ready yet : try again a bit later, until the fixed wait
+    if (ret == ERR_NACK && s->state == STEP_SENT && _Polling && now < s->sent + c.wait) {
+        s->due = now + POLL_START;
+        if (s->due > s->sent + c.wait) s->due = s->sent + c.wait;
+        return;
     }
 
-    if (GetId(SHTC1_ADDRESS, buf) != true) {
-        if (_SVM30_Debug) printf("Error during probe SHTC1 at address 0x%x\n", SHTC1_ADDRESS);
-        return(false);
+    if (ret == ERR_OK) {
+        frame.Decode(s->resp);
+        s->state = STEP_OK;
     }
 
-    return(true);
+    // repeat the command from the start or give up
+    if (Retry(c, ret, s->attempt, &backoff)) {
+        s->state = STEP_WAIT;
+        s->due = now + backoff;
+    }
+    else if (ret != ERR_OK) {
+        s->state = STEP_FAIL;
+        s->err = ret;
+    }
 }
 
 /**
- * @brief : Trigger a read on the SGP30
- *
- * The on-chip baseline compensation algorithm has been optimized
- * for 1HZ sampling rate. The sensor shows best performance when
- * used with this sampling rate.
- *
- * Sample rate to be implemented in the user program (see examples)
+ * @brief : return the result of an asynchronous measurement
+ * @param v : pointer to structure to update (only measured fields)
  *
- * @return :
- *   true on success else false
+ * @return : fields that were measured (0 = none or not done)
  */
-bool SVM30::TriggerSGP30() {
-    // Start SGP30 measurement if not started already?
-    if (! StartSGP30()) return(false);
+uint8_t SVM30::GetResult(struct svm_values *v) {
+    svm30_guard g(&_Api);
+    uint8_t i, done = 0;
 
-    // get TVOC and CO2 equivalent data
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Measure_Air_Quality);
+    if (_Async != ASYNC_DONE && _Async != ASYNC_FAILED) return(0);
 
-    // send Request and read from sensor
-    if (RequestFromSVM(4) != ERR_OK) {
-        if (_SVM30_Debug) printf("Error during reading TVOC and CO2\n");
-        return(false);
-    }
+    for (i = 0; i < _Steps; i++) {
+        struct svm_step *s = &_Step[i];
 
-    return(true);
-}
+        // the other fields are still stored
+        if (s->state != STEP_OK) {
+            if (s->field) StoreFailed(v, s->field, s->err);
+            continue;
+        }
 
-/**
- * @brief : get Inceptivebaseline  (impact TVOC only)
- *
- * See datasheet May 2020 SGP30
- *
- * !!! REQUIRES LEVEL 34 FEATURE SET !!!
- * @param *baseline
- *   Store the baseline
- *
- * @return :
- *   true on success else false
- */
-bool SVM30::GetInceptiveBaseLine_TVOC(uint16_t *baseline) {
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Get_tvoc_inceptive_baseline);
+        if (s->field == SVM_AQ) {
+            StoreAirQuality(v, s->resp);
 
-    // send Request and read from sensor
-    if (RequestFromSVM(2) != ERR_OK) {
-        if (_SVM30_Debug) printf("Error during reading Inceptivebaseline\n");
-        return(false);
+            pthread_mutex_lock(&_SampleLock);
+            Aggregate(v);
+            pthread_mutex_unlock(&_SampleLock);
+        }
+        else if (s->field == SVM_RAW) {
+            StoreRawSignals(v, s->resp);
+        }
+        else if (s->field == SVM_TH) {
+            StoreTempHum(v, s->resp);
+        }
+        else if (s->cmd == &CMD_SGP30_Set_Humidity) {
+            HumiditySent(s->param[0]);
+        }
+
+        done |= s->field;
     }
 
-    // copy baseline
-    *baseline = byte_to_uint16(0);
+    _Async = ASYNC_IDLE;
+    _Steps = 0;
 
-    return(true);
+    return(done);
 }
 
 /**
- * @brief : set Inceptivebaseline  (impact TVOC only)
+ * @brief : measure SGP30 and SHTC1 at the same time
  *
- * See datasheet May 2020 SGP30
+ * @param v : pointer to structure to update
+ * @param raw : measure raw signals. The caller checks Supported() :
+ * GetValues() clears it for an SGP30 without raw signals and GetDue()
+ * does not return SVM_RAW for one.
  *
- * !!! REQUIRES LEVEL 34 FEATURE SET !!!
- * @param baseline
- *      Store the baseline to set (previous obtained with GetInceptiveBaseLine_TVOC
+ * The SHTC1 conversion is started first and collected while the SGP30
+ * measures. The SGP30 can only handle one measurement at a time, so the
+ * raw signals are started after the air quality has been collected.
+ * A field that fails is marked in its quality.
  *
- * @return :
- *   true on success else false
+ * @return : SVM_AQ, SVM_RAW and/or SVM_TH for the updated fields
  */
-bool SVM30::SetInceptiveBaseLine_TVOC(uint16_t baseline) {
-    char    data[2];
+uint8_t SVM30::Pipeline(struct svm_values *v, bool raw) {
+    uint16_t aq[2], rs[2], th[2];
+    uint64_t m_th = 0, m_aq = 0, m_rs = 0;
+    uint8_t r_th, r_aq = ERR_CMDSTATE, r_rs = ERR_CMDSTATE, done = 0;
+    bool sgp = StartSGP30();
 
-    if (baseline == 0x0) {
-         if (_SVM30_Debug) printf("Error during setting Inceptivebaseline. Baseline can NOT be zero\n");
-         return(false);
-    }
+    if (sgp) SendHumidity();
 
-    data[0] = (baseline >> 8) & 0xff;// MSB
-    data[1] = baseline & 0xff;       // LSB
+    Claim();
 
-    PrepSendBuffer(SGP30_ADDRESS, SGP30_Set_tvoc_inceptive_baseline, data, 2);
+    r_th = Start<CMD_SHTC1_Read_Temp_First>(m_th);
+    if (sgp) r_aq = Start<CMD_SGP30_Measure_Air_Quality>(m_aq);
 
-    // send Request to sensor
-    if (SendToSVM() != ERR_OK) {
-        if (_SVM30_Debug) printf("Error during setting Inceptivebaseline\n");
-        return(false);
-    }
+    if (r_aq == ERR_OK) r_aq = Collect<CMD_SGP30_Measure_Air_Quality>(m_aq, aq);
 
-    return(true);
-}
+    if (raw && r_aq == ERR_OK) r_rs = Start<CMD_SGP30_Measure_Raw_Signals>(m_rs);
 
-/**
- * @brief : read all measurement values from the sensor and store in structure
- * @param v: pointer to structure to store
- * 
- * @param raw: if true it will try to read the raw values from the SGP30 (update 1.2)
- *
- * It seems that older version of the SGP30 do not support reading raw, hence the "raw" -option
- * has been added as an option to exclude. By default it will read to stay backward compatible
- *
- * @return :
- *   true on success else false
- */
-bool SVM30::GetValues(struct svm_values *v, bool raw) {
-    memset(v,0x0,sizeof(struct svm_values));
+    if (r_th == ERR_OK) r_th = Collect<CMD_SHTC1_Read_Temp_First>(m_th, th);
 
-    /** data from SGP30  */
-    if (TriggerSGP30() == false) return(false);
+    if (raw && r_rs == ERR_OK) r_rs = Collect<CMD_SGP30_Measure_Raw_Signals>(m_rs, rs);
 
-    v->CO2eq = byte_to_uint16(0);
-    v->TVOC  = byte_to_uint16(2);
+    Release();
 
-    if (raw) {
-        // get raw H2 signal and Ethanol signal
-        PrepSendBuffer(SGP30_ADDRESS, SGP30_Measure_Raw_Signals);
-    
-        // send Request and read from sensor
-        if (RequestFromSVM(4) != ERR_OK) {
-            if (_SVM30_Debug) printf("Error during reading Raw signals\n");
-            return(false);
-        }
-    
-        v->H2_signal = byte_to_uint16(0);
-        v->Ethanol_signal  = byte_to_uint16(2);
+    // a step that failed is repeated on its own (with retries)
+    if (sgp && r_aq != ERR_OK) r_aq = Request<CMD_SGP30_Measure_Air_Quality>(aq);
+    if (sgp && raw && r_rs != ERR_OK) r_rs = Request<CMD_SGP30_Measure_Raw_Signals>(rs);
+    if (r_th != ERR_OK) r_th = Request<CMD_SHTC1_Read_Temp_First>(th);
+
+    if (r_aq == ERR_OK) {
+        StoreAirQuality(v, aq);
+        done |= SVM_AQ;
     }
     else {
-        v->H2_signal = 0;
-        v->Ethanol_signal  = 0;
+        if (_SVM30_Debug) printf("Error during reading TVOC and CO2\n");
+        StoreFailed(v, SVM_AQ, r_aq);
     }
 
-    /** data from SHTC1 */
-    PrepSendBuffer(SHTC1_ADDRESS, SHTC1_Read_Temp_First);
+    if (raw && r_rs == ERR_OK) {
+        StoreRawSignals(v, rs);
+        done |= SVM_RAW;
+    }
+    else if (raw) {
+        if (_SVM30_Debug) printf("Error during reading Raw signals\n");
+        StoreFailed(v, SVM_RAW, r_rs);
+    }
 
-    // send Request and read from sensor
-    if (RequestFromSVM(4) != ERR_OK) {
+    if (r_th == ERR_OK) {
+        StoreTempHum(v, th);
+        done |= SVM_TH;
+    }
+    else {
         if (_SVM30_Debug) printf("Error during reading SHTC1\n");
+        StoreFailed(v, SVM_TH, r_th);
+    }
+
+    return(done);
+}
+
+/**
+ * @brief : decide whether to repeat a command
+ * @param c : command descriptor (see svm30cmd.h)
+ * @param ret : result of the last attempt
+ * @param attempt : number of the last attempt (updated)
+ * @param backoff : if not NULL, store the time to wait before repeating
+ * instead of waiting (asynchronous API)
+ *
+ * @return : true to repeat the command, else false
+ *
+ * Only bus errors are repeated. A NACK means the device is (still) busy,
+ * any other bus error could be a device holding SDA low, in which case
+ * the bus is recovered first.
+ */
+bool SVM30::Retry(const svm30_cmd &c, uint8_t ret, uint8_t &attempt, useconds_t *backoff) {
+    uint32_t delay;
+
+    if (attempt == 0) _RetryWaited = 0;
+
+    if (ret == ERR_OK) {
+        if (attempt > 0) _Retry.recovered++;
+        _NackFail = 0;
         return(false);
     }
 
-    // get the raw values from the SHTC
-    v->r_temperature = byte_to_uint16(0);
-    v->r_humidity  = byte_to_uint16(2);
+    // not a bus error or a command that is not repeated (not counted)
+    if (ret != ERR_NACK && ret != ERR_PROTOCOL && ret != ERR_TIMEOUT) return(false);
+    if (c.retry == 0) return(false);
 
-    // convert to useable temperature and humidity
-    shtc1_conv(&v->temperature, &v->humidity, v->r_temperature, v->r_humidity);
+    delay = (c.max > RETRY_START ? c.max : RETRY_START) << attempt;
 
-    // calculate absolute humidity
-    calc_absolute_humidity(v);
+    if (attempt >= c.retry || _RetryWaited + delay > RETRY_BUDGET) {
+        if (_SVM30_Debug) printf("Command 0x%04X failed after %d retries\n", c.cmd, attempt);
+        _Retry.failures++;
 
-    // calculate heat Index
-    computeHeatIndex(v);
+        // only NACK's : nothing answers on the bus
+        if (ret != ERR_NACK) _NackFail = 0;
+        else if (++_NackFail >= ABSENT_NACKS && _Present) {
+            if (_SVM30_Debug) printf("SVM30 not responding, considered absent\n");
+            _Present = false;
+            _LastProbe = time(NULL);
+            _Retry.absent++;
+        }
 
-    // calculate dew_point
-    calc_dewpoint(v);
+        return(false);
+    }
 
-    return(true);
-}
+    // BCM2835 clocks the bus free, with i2c-dev the kernel adapter driver
+    // has done so already (see SVM30_i2cdev::Recover())
+    if (ret != ERR_NACK) {
+        _Retry.bus_recovery++;
+        Claim();
+        if (! _I2C->Recover() && _SVM30_Debug) printf("Bus recovery not possible\n");
+        Release();
+    }
 
-/**
- * @brief : translate 2 bytes to uint16
- * @param x : offset in _Receive_BUF
- *
- * assumed is MSB first, LSB second byte
- *
- * @return : uint16_t number
- */
-uint16_t SVM30::byte_to_uint16(int x) {
-    uint16_t val;
-    val =  _Receive_BUF[x] << 8 | _Receive_BUF[x+1];
-    return val;
+    if (_SVM30_Debug) printf("Retry command 0x%04X in %duS\n", c.cmd, delay);
+
+    if (backoff) *backoff = delay;
+    else _I2C->Delay(delay);
+
+    _RetryWaited += delay;
+    _Retry.retries++;
+    attempt++;
+
+    return(true);
 }
 
 /**
  * @brief : Fill buffer to send over I2C communication
- * @param device : I2C address to use (either SGP30 or SHTC1)
- * @param cmd: I2C commmand for device
- * @param param : additional parameters to add
- * @param len : length of parameters to add (zero if none)
+ * @param c : command descriptor (see svm30cmd.h)
+ * @param param : parameter words to add (c.param words)
  *
  */
-void SVM30::PrepSendBuffer(uint8_t device, uint16_t cmd, char *param, uint8_t len) {
-    uint8_t     i = 0, j, c;
+void SVM30::PrepSendBuffer(const svm30_cmd &c, const uint16_t *param) {
+    uint8_t     i = 0, j;
 
-    _I2C_address = device;
+    SetCommand(c);
 
     // add command
-    _Send_BUF[i++] = cmd >> 8 & 0xff;   //0 MSB
-    _Send_BUF[i++] = cmd & 0xff;        //1 LSB
-
-    // additional parameters to add?
-    if (len != 0) {
+    _Send_BUF[i++] = c.cmd >> 8 & 0xff;   //0 MSB
+    _Send_BUF[i++] = c.cmd & 0xff;        //1 LSB
+
+    // add parameters, each followed by CRC
+    for (j = 0 ; j < c.param; j++) {
+        _Send_BUF[i++] = param[j] >> 8 & 0xff;
+        _Send_BUF[i++] = param[j] & 0xff;
+        _Send_BUF[i] = svm30_crc8(&_Send_BUF[i - 2]);
+        i++;
+    }
+    
+    _Send_BUF_Length = i;
+}
 
-        for (j = 0, c = 0 ; j < len; j++) {
+/**
+ * @brief : select the command to handle (address, timing)
+ * @param c : command descriptor (see svm30cmd.h)
+ */
+void SVM30::SetCommand(const svm30_cmd &c) {
 
-            // add bytes
-            _Send_BUF[i++] = param[j];
+    _I2C_address = c.address;
+    _Cmd = &c;
 
-            // add CRC after each 2 bytes
-            if(++c == 2){
-                _Send_BUF[i] = CalcCrC(&_Send_BUF[i - 2]);
-                i++;
-                c = 0;
-            }
-        }
-    }
-    
     // 1.2 : the delay is now depending on the Measurement Commands typical
     // timing as defined in the datasheet table 13
     // MUCH longer times needs on Rasperry (table timing * 2))
-
-    switch(cmd) {
-        case SGP30_Measure_Test:
-            _wait = 500000;     // 500mS
-            break;
-        case SGP30_Measure_Raw_Signals:
-            _wait = 250000;      // 250mS
-            break;
-        default:
-            _wait = 50000;      // default 50mS
-            break;
-    }
-
-    _Send_BUF_Length = i;
+    // 1.3 : taken from the command descriptor. The SHTC1 ID can be read
+    // directly after the command has been acknowledged (no wait). This
+    // allows a combined write/read transaction.
+    _wait = c.wait;
 }
 
 /**
  * @brief : send a prepared command (with PrepsendBuffer())
+ * @param settle : if true wait for the command to be handled
  *
  * @return :
  * Ok ERR_OK
  * else error
  */
-uint8_t SVM30::SendToSVM() {
+uint8_t SVM30::SendToSVM(bool settle) {
     
     uint8_t i;
     
@@ -800,31 +2279,50 @@ uint8_t SVM30::SendToSVM() {
     _Send_BUF_Length = 0;
 
     // give time to settle
-    usleep(_wait);
+    if (settle) I2C_wait(_wait);
 
     return(ERR_OK);
 }
 
 /**
  * @brief : sent command/request and read from SVM30 sensor
- * @param cnt: number of data bytes to get
+ * @param buf : store the received bytes (words + CRC)
+ * @param len : number of bytes to get
  *
  * @return :
  * OK   ERR_OK
  * else error
  */
-uint8_t SVM30::RequestFromSVM(uint8_t cnt) {
+uint8_t SVM30::RequestFromSVM(uint8_t *buf, uint8_t len) {
     uint8_t ret, i;
 
-    // sent Request
-    ret = SendToSVM();
-    if (ret != ERR_OK) {
-        if (_SVM30_Debug) printf("Can not sent request\n");
-        return(ret);
+    // no wait needed : sent request and read in one transaction
+    if (_wait == 0) {
+
+        if (_Send_BUF_Length == 0) return(ERR_DATALENGTH);
+
+        if (_SVM30_Debug) {
+            printf("Sending to 0x%x: ",_I2C_address );
+            for(i = 0; i < _Send_BUF_Length; i++)
+                printf("0x%02X ", _Send_BUF[i]);
+        }
+
+        ret = ReadFromSVM(buf, len, true);
+
+        _Send_BUF_Length = 0;
     }
+    else {
+        // sent Request
+        ret = SendToSVM(! _Polling);
+        if (ret != ERR_OK) {
+            if (_SVM30_Debug) printf("Can not sent request\n");
+            return(ret);
+        }
 
-    // read from Sensor
-    ret = ReadFromSVM(cnt);
+        // read from Sensor
+        if (_Polling) ret = PollFromSVM(buf, len);
+        else ret = ReadFromSVM(buf, len);
+    }
 
     if (ret != ERR_OK) {
        if (_SVM30_Debug)  printf("Error during reading. Errorcode: 0x%02X\n", ret);
@@ -832,99 +2330,126 @@ uint8_t SVM30::RequestFromSVM(uint8_t cnt) {
 
     if (_SVM30_Debug){
        printf(", Received: ");
-       for(i = 0; i < _Receive_BUF_Length; i++) printf("0x%02X ",_Receive_BUF[i]);
-       printf("length: %d\n",_Receive_BUF_Length);
+       for(i = 0; i < len; i++) printf("0x%02X ",buf[i]);
+       printf("length: %d\n",len);
     }
 
     return(ret);
 }
 
 /**
- * @brief       : receive from Sensor
- * @param count : number of data bytes to read
+ * @brief : poll the sensor until the result is ready
+ * @param buf : store the received bytes (words + CRC)
+ * @param len : number of bytes to get
+ *
+ * The sensor will NACK the read as long as the result is not ready.
+ * The first read is done after the typical command duration. After a
+ * NACK the time in between reads starts at POLL_START and doubles up
+ * to POLL_MAX. After _wait (the fixed wait time) one last read is done.
+ *
+ * If a read is rejected with another error than NACK, while a read
+ * after the fixed wait succeeds, the interface does not report NACK.
+ * In that case polling is disabled and the fixed wait is used.
  *
  * @return :
  * OK   ERR_OK
  * else error
  */
-#define TBUF 10
-uint8_t SVM30::ReadFromSVM(uint8_t count) {
-    uint8_t data[3];
-    uint8_t i, j, x, y;
-    uint8_t tmp_buf[TBUF];
+uint8_t SVM30::PollFromSVM(uint8_t *buf, uint8_t len, useconds_t elapsed) {
+    useconds_t backoff = POLL_START, first;
+    uint8_t ret;
 
-    j = i = _Receive_BUF_Length = 0;
-    x = count / 2 * 3;
-    if (x > TBUF) x = TBUF;
-    
-    // read from device
-    i = I2C_read((char *) tmp_buf, x);
-    if (i != ERR_OK) return(i);
+    // typical time needed for the command (minus the time passed already)
+    first = _Cmd->typ < _wait ? _Cmd->typ : _wait;
 
-    /* parse the response */
-    for (y = 0; y < x; y++)
-    {
-        data[i++] = tmp_buf[y];
+    if (first > elapsed) {
+        I2C_wait(first - elapsed);
+        elapsed = first;
+    }
 
-        // 2 bytes RH, 1 CRC
-        if( i == 3) {
+    while (1) {
 
-            if (data[2] != CalcCrC(&data[0])){
-                if (_SVM30_Debug){
-                    printf("I2C CRC error: Expected 0x%02X, calculated 0x%02X\n",data[2] & 0xff,CalcCrC(&data[0]) &0xff);
-                }
-                return(ERR_PROTOCOL);
-            }
+        ret = ReadFromSVM(buf, len);
 
-            _Receive_BUF[_Receive_BUF_Length++] = data[0];
-            _Receive_BUF[_Receive_BUF_Length++] = data[1];
+        // result (or a real error) or all time used
+        if (ret != ERR_NACK || elapsed >= _wait) break;
 
-            i = 0;
+        // not ready yet : wait a bit longer each time, up to _wait
+        if (elapsed + backoff > _wait) backoff = _wait - elapsed;
 
-            if (_Receive_BUF_Length >= count) break;
-        }
-    }
+        I2C_wait(backoff);
+        elapsed += backoff;
 
-    if (i != 0) {
-        if (_SVM30_Debug) printf("Error: Data counter %d\n",i);
-        while (j < i) _Receive_BUF[_Receive_BUF_Length++] = data[j++];
+        if (backoff < POLL_MAX) backoff *= 2;
     }
 
-    if (_Receive_BUF_Length == 0) {
-        if (_SVM30_Debug)  printf("Error: Received NO bytes\n");
-        return(ERR_PROTOCOL);
+    // anything other than NACK before the fixed wait time
+    if (ret != ERR_OK && ret != ERR_NACK && elapsed < _wait) {
+
+        I2C_wait(_wait - elapsed);
+
+        ret = ReadFromSVM(buf, len);
+
+        if (ret == ERR_OK) {
+            if (_SVM30_Debug) printf("NACK not reported, fall back to fixed wait\n");
+            _Polling = false;
+        }
     }
 
-    if (_Receive_BUF_Length == count) return(ERR_OK);
+    return(ret);
+}
+
+/**
+ * @brief : read the response of a command that was sent earlier
+ * @param buf : store the received bytes (words + CRC)
+ * @param len : number of bytes to get
+ * @param elapsed : time (uS) passed since the command was sent
+ *
+ * @return : ERR_OK or error
+ */
+uint8_t SVM30::CollectFromSVM(uint8_t *buf, uint8_t len, useconds_t elapsed) {
+
+    if (_Polling) return(PollFromSVM(buf, len, elapsed));
 
-    if (_SVM30_Debug)
-        printf("Error: Expected bytes : %d, Received bytes %d\n", count,_Receive_BUF_Length);
+    if (elapsed < _wait) I2C_wait(_wait - elapsed);
 
-    return(ERR_DATALENGTH);
+    return(ReadFromSVM(buf, len));
 }
 
 /**
- * @brief : calculate CRC for I2c comms
- * @param data : 2 databytes to calculate the CRC from
+ * @brief       : receive from Sensor
+ * @param buf   : store the received bytes (words + CRC)
+ * @param len   : number of bytes to read
+ * @param combined : if true, the prepared command is sent in the same
+ *                   transaction as the read (repeated start)
  *
- * Source : datasheet SPS30
+ * The bytes are read straight into the frame of the caller and the
+ * CRC of each word is checked in place (see svm30frame.h).
  *
- * return CRC
+ * @return :
+ * OK   ERR_OK
+ * else error
  */
-uint8_t SVM30::CalcCrC(uint8_t *data) {
-    uint8_t crc = 0xFF;
-    for(int i = 0; i < 2; i++) {
-        crc ^= data[i];
-        for(uint8_t bit = 8; bit > 0; --bit) {
-            if(crc & 0x80) {
-                crc = (crc << 1) ^ 0x31u;
-            } else {
-                crc = (crc << 1);
-            }
+uint8_t SVM30::ReadFromSVM(uint8_t *buf, uint8_t len, bool combined) {
+    uint8_t i;
+
+    // read from device
+    if (combined) i = I2C_transfer((char *) buf, len);
+    else i = I2C_read((char *) buf, len);
+    if (i != ERR_OK) return(i);
+
+    /* check the response : 2 bytes data, 1 CRC */
+    i = svm30_crc_check(buf, len / 3);
+
+    if (i != len / 3) {
+        if (_SVM30_Debug){
+            printf("I2C CRC error word %d: Expected 0x%02X, calculated 0x%02X\n",
+            i, buf[i * 3 + 2], svm30_crc8(&buf[i * 3]));
         }
+        return(ERR_PROTOCOL);
     }
 
-    return crc;
+    return(ERR_OK);
 }
 
 /**
@@ -962,27 +2487,64 @@ void SVM30::calc_absolute_humidity(struct svm_values *v) {
  * value of 15.50 g/m3 (15 g/m3 + 128/256 g/m 3 ).
  */
 uint16_t SVM30::ConvAbsolute(float AbsoluteHumidity) {
-    uint16_t val;
-    int val1;
+    long val;
+
+    // 1.3 : the fraction is in 1/256 (was * 100), rounded
+    val = lroundf(AbsoluteHumidity * 256);
+
+    // 0x0000 would turn the compensation off
+    if (val < 0x0001) val = AbsoluteHumidity > 0 ? 0x0001 : 0x0000;
+    if (val > 0xFFFF) val = 0xFFFF;
+
+    return((uint16_t) val);
+}
+
+/**
+ * @brief : check whether the humidity compensation must be sent
+ *
+ * @return :
+ *   true if the measured humidity differs more than HUM_DEADBAND from
+ *   the one sent or HUM_MAXAGE has passed, else false
+ */
+bool SVM30::HumidityDue() {
+
+    if (! _HumComp || _HumTarget == 0) return(false);
+
+    if (_HumSent == 0 || GetTime() - _HumSent > (uint64_t) HUM_MAXAGE * 1000) return(true);
+
+    return(abs((int) _HumTarget - (int) _Humidity) > HUM_DEADBAND);
+}
+
+/**
+ * @brief : send the humidity compensation if needed
+ */
+void SVM30::SendHumidity() {
+    uint16_t data[1] = {_HumTarget};
 
-    // get top 8 bits (MSB)
-    val = (uint16_t) AbsoluteHumidity;
+    if (! HumidityDue()) return;
 
-    // get bottom 8 bits (LSB)
-    val1 = (AbsoluteHumidity - (float) val) * 100;
+    if (Command<CMD_SGP30_Set_Humidity>(data) != ERR_OK) {
+        if (_SVM30_Debug) printf("Error during setting humidity\n");
+        return;
+    }
 
-    val = val << 8 | val1;
-    // printf("val 0x%x, val1 %d / 0x%x\n", val,val1, val1);
+    HumiditySent(data[0]);
+}
 
-    return(val);
+/**
+ * @brief : remember the humidity compensation on the SGP30
+ * @param humidity : absolute humidity sent (8.8)
+ */
+void SVM30::HumiditySent(uint16_t humidity) {
+    _Humidity = humidity;
+    _HumSent = GetTime();
 }
 
 /*****************************************************************
  * I2C routines
  * 
- * the embedded hardware I2C channel can be used as the SVM30 is
- * not using clock stretching
- * 
+ * the actual bus access is handled by the selected transport
+ * (see svm30i2c.h)
  ****************************************************************/
 /**
  * @brief : Start I2C communication
@@ -990,28 +2552,18 @@ uint16_t SVM30::ConvAbsolute(float AbsoluteHumidity) {
  * @return
  * All good : true
  * false : error
- * 
  */
 bool SVM30::I2C_init()
 {
-     if (!bcm2835_init()) {
-        printf("Can't init bcm2835!\n");
-        return(false);
-    }
+    bool ret;
 
-    // will select I2C channel 0 or 1 depending on board version.
-    if (!bcm2835_i2c_begin()) {
-        printf("Can't setup I2c pin!\n");
-        
-        // release BCM2835 library
-        bcm2835_close();
-        return(false);
-    }
-    
-    /* set BSC speed to 100Khz*/
-    bcm2835_i2c_setClockDivider(BCM2835_I2C_CLOCK_DIVIDER_2500);
-   
-    return(true);
+    _I2C->EnableDebugging(_SVM30_Debug);
+
+    _I2C->Lock();
+    ret = _I2C->Open();
+    _I2C->Unlock();
+
+    return(ret);
 }
 
 /**
@@ -1023,30 +2575,10 @@ bool SVM30::I2C_init()
  * @return
  * All good : ERR_OK
  * else error
- * 
  */
 uint8_t SVM30::I2C_read(char *buf, uint8_t len)
 {
-       
-    switch(bcm2835_i2c_read(buf, len))
-    {
-        case BCM2835_I2C_REASON_ERROR_NACK :
-            if(_SVM30_Debug) printf(REDSTR,"DEBUG: Read NACK error\n");
-            return(ERR_PROTOCOL);
-            break;
-
-        case BCM2835_I2C_REASON_ERROR_CLKT :
-            if(_SVM30_Debug) printf(REDSTR,"DEBUG: Read Clock stretch error\n");
-            return(ERR_PROTOCOL);
-            break;
-
-        case BCM2835_I2C_REASON_ERROR_DATA :
-            if(_SVM30_Debug) printf(REDSTR,"DEBUG: not all data has been read\n");
-            return(ERR_PROTOCOL);
-            break;
-    }
-    
-    return(ERR_OK);
+    return(_I2C->Read(_I2C_address, (uint8_t *) buf, len));
 }
 
 /**
@@ -1056,40 +2588,52 @@ uint8_t SVM30::I2C_read(char *buf, uint8_t len)
  */
 uint8_t SVM30::I2C_write()
 {
-    /* set slaveaddress */
-    bcm2835_i2c_setSlaveAddress(_I2C_address);
- 
-    switch(bcm2835_i2c_write( (char*) _Send_BUF, _Send_BUF_Length))
-    {
-        case BCM2835_I2C_REASON_ERROR_NACK :
-            if(_SVM30_Debug) printf(REDSTR,"DEBUG: Write NACK error\n");
-            return(ERR_PROTOCOL);
-            break;
-
-        case BCM2835_I2C_REASON_ERROR_CLKT :
-            if(_SVM30_Debug) printf(REDSTR,"DEBUG: Write Clock stretch error\n");
-            return(ERR_PROTOCOL);
-            break;
+    return(_I2C->Write(_I2C_address, _Send_BUF, _Send_BUF_Length));
+}
 
-        case BCM2835_I2C_REASON_ERROR_DATA :
-            if(_SVM30_Debug) printf(REDSTR,"DEBUG: not all data has been written\n");
-            return(ERR_PROTOCOL);
-            break;
-    }
-    
-    return(ERR_OK);
+/**
+ * @brief : write send buffer to Device and read the response
+ * in one transaction (repeated start)
+ * 
+ * @param buf : buffer to store bytes
+ * @param len : number of bytes to read
+ * 
+ * @return : Success is ERR_OK, else error
+ */
+uint8_t SVM30::I2C_transfer(char *buf, uint8_t len)
+{
+    return(_I2C->Transfer(_I2C_address, _Send_BUF, _Send_BUF_Length, (uint8_t *) buf, len));
 }
 
 /**
- * @brief : close library and reset pins.
+ * @brief : close I2C communication
  */
 void SVM30::I2C_close()
 {
-    // reset pins
-    bcm2835_i2c_end();  
-    
-    // release BCM2835 library
-    bcm2835_close();
+    _I2C->Lock();
+    _I2C->Close();
+    _I2C->Unlock();
+}
+
+/**
+ * @brief : wait for the device during an exchange
+ *
+ * @param us : time to wait in micro seconds
+ *
+ * The bus is released while waiting, so other sensors on the bus (e.g.
+ * on another multiplexer channel) can be served by other threads of
+ * this process in the mean time. Other processes have to wait, the
+ * cross-process lock (BusLock()) is kept. The device lock is kept as
+ * well, so this device does not get another command before the
+ * response has been read.
+ */
+void SVM30::I2C_wait(useconds_t us)
+{
+    _Waited += us;
+
+    _I2C->Unlock();
+    _I2C->Delay(us);
+    _I2C->Lock();
 }
 
 /********************************************************************
@@ -48,6 +48,38 @@
  *
  * - added raw boolean (default true) to include(true) / exclude (false) raw data
  * - added read-delay setting based on the kind of command request.
+ *
+ * Version 1.3 / October 2026
+ * - added Linux i2c-dev (/dev/i2c-N) interface as alternative to BCM2835 (make I2C=dev)
+ * - added combined write/read transaction (repeated start) for commands without wait
+ * - added pluggable I2C transport (svm30i2c.h) and SVM30 simulator (svm30sim.h)
+ * - added readiness polling instead of fixed wait after a command
+ * - added compile-time command descriptors (svm30cmd.h)
+ * - added frame codec with table driven CRC (svm30frame.h), no limit on response length
+ * - added I2C capture and replay (svm30capture.h)
+ * - added I2C fault injection (svm30fault.h)
+ * - added retry with backoff and bus recovery for failed commands
+ * - added TCA9548A multiplexer support (svm30mux.h)
+ * - added per bus locking, SVM30 objects can be used from different threads
+ * - begin() no longer does a general call reset, only device specific resets
+ * - added hot-unplug detection and resume with last known baselines / humidity
+ * - added cross-process bus lock (flock) for each exchange
+ * - added pipelined SGP30 / SHTC1 measurements in GetValues()
+ * - added measurement per signal, Sample() with interval per signal and time stamps
+ * - added sampler thread with absolute 1Hz deadlines and jitter statistics
+ * - added min / max / mean / median of the 1Hz CO2eq / TVOC readings
+ * - added asynchronous state machine API with a pollable timerfd
+ * - added GetDue() and GetAggregate() for callers with their own timer
+ * - added quality per field (failed, CRC, stale, warm-up, out of range),
+ *   GetValues() continues after a failed field
+ * - added attach mode : begin() continues with a measuring SGP30
+ * - added baseline store : hourly checkpoint per SGP30 serial, restore at begin()
+ * - added baseline cache : one Get_Baseline per GetBaseLines(), one Set_Baseline
+ *   for either half, GetCachedBaseLines() for periodic display
+ * - added humidity compensation controller (SetHumidityComp()), corrected
+ *   the 8.8 fixed point encoding of the absolute humidity
+ * - added capabilities read by begin() (GetCaps()), commands the SGP30
+ *   feature set does not support are skipped
  *********************************************************************
  */
 #ifndef SVM30_H
@@ -56,12 +88,17 @@
 # include <stdio.h>
 # include <string.h>
 # include <unistd.h>
-# include <bcm2835.h>
+# include <stdint.h>
 # include <math.h>
 # include <stdlib.h>        // needed for abs())
+# include <time.h>
+# include <errno.h>
+# include <signal.h>
+
+# include "svm30i2c.h"      // I2C transport
 
 // set driver version
-#define VERSION "1.2 / August 2020";
+#define VERSION "1.3 / October 2026";
 
 /* structure to return measurement values */
 struct svm_values
@@ -77,6 +114,128 @@ struct svm_values
     uint16_t   Ethanol_signal;// SGP30 Raw ethanol signal
     float       heat_index;    // calculated heat-index
     float       dew_point;     // calculated dew point
+    uint64_t   t_aq;          // time CO2eq / TVOC measured (mS, 0 = never)
+    uint64_t   t_raw;         // time H2 / Ethanol measured (mS, 0 = never)
+    uint64_t   t_th;          // time temperature / humidity measured (mS, 0 = never)
+    uint8_t    q_aq;          // quality CO2eq / TVOC (SVM_Q_*, 0 = good)
+    uint8_t    q_raw;         // quality H2 / Ethanol signals
+    uint8_t    q_th;          // quality temperature / humidity
+};
+
+/* intervals for Sample() in mS (0 = do not measure) */
+struct svm_schedule
+{
+    uint32_t   aq;            // CO2eq / TVOC (SGP30 needs 1000)
+    uint32_t   raw;           // H2 / Ethanol signals
+    uint32_t   th;            // temperature / humidity
+};
+
+/* fields updated by Sample() */
+#define SVM_AQ      0x01
+#define SVM_RAW     0x02
+#define SVM_TH      0x04
+
+/* quality of a field in svm_values (0 = good)
+ * A field that could not be measured keeps its earlier value : FAILED +
+ * STALE, the time stamp tells how old it is. FAILED alone : no value. */
+#define SVM_Q_FAILED  0x01    // last measurement failed
+#define SVM_Q_CRC     0x02    // it failed on a CRC / protocol error, else no answer
+#define SVM_Q_STALE   0x04    // value is of an earlier measurement
+#define SVM_Q_WARMUP  0x08    // SGP30 warm-up : fixed 400 ppm / 0 ppb
+#define SVM_Q_RANGE   0x10    // outside the specified range of the sensor
+
+/* SGP30 returns fixed values the first 15 seconds after Init_Air_Quality */
+#define WARMUP_TIME   15000   // mS
+
+/* baseline store (see SetBaselineStore()) */
+#define BASE_INTERVAL 3600    // seconds between checkpoints
+#define BASE_LEARN    43200   // seconds to learn a new baseline (12 hours)
+#define BASE_MAXAGE   604800  // seconds a stored baseline is valid (7 days)
+
+/* SetBaseLine_CO2/TVOC() re-read the other half when the cache is older */
+#define BASE_CACHE    60      // seconds
+
+/* humidity compensation (see SetHumidityComp()) */
+#define HUM_DEADBAND  0x0020  // change (8.8, 0.125 g/m3) before it is sent
+#define HUM_MAXAGE    300     // seconds after which it is sent anyway
+
+/* statistics of the readings of one signal */
+struct svm_stat
+{
+    uint16_t   min;
+    uint16_t   max;
+    uint16_t   last;
+    uint16_t   median;        // of the last AGG_MAX readings
+    float      mean;
+};
+
+/* CO2eq / TVOC readings since the previous WaitSample() / GetAggregate() */
+struct svm_aggregate
+{
+    uint32_t   count;         // number of readings (0 = none)
+    struct svm_stat CO2eq;
+    struct svm_stat TVOC;
+};
+
+/* readings kept for the median (10 minutes at 1Hz) */
+#define AGG_MAX     600
+
+/* state of an asynchronous measurement (see StartMeasurement()) */
+#define ASYNC_IDLE      0       // no measurement
+#define ASYNC_BUSY      1       // in progress, wait on ReadyFd()
+#define ASYNC_DONE      2       // result available, see GetResult()
+#define ASYNC_FAILED    3       // all commands failed
+
+struct svm30_cmd;
+
+/* one command of an asynchronous measurement */
+struct svm_step
+{
+    const svm30_cmd *cmd;     // command descriptor
+    uint8_t    field;         // SVM_AQ, SVM_RAW or SVM_TH (0 = no response)
+    uint8_t    state;         // STEP_*
+    uint8_t    attempt;       // retries done
+    uint64_t   sent;          // time command was sent (uS)
+    uint64_t   due;           // time of next action (uS)
+    uint16_t   resp[2];       // response words
+    uint16_t   param[1];      // parameter word
+    uint8_t    err;           // result of the last attempt
+};
+
+/* sampler thread statistics (times in uS) */
+struct svm_sampler
+{
+    uint32_t   ticks;         // deadlines handled
+    uint32_t   missed;        // deadlines skipped as the previous tick overran
+    uint32_t   late_max;      // maximum wake-up delay after a deadline
+    uint64_t   late_sum;      // sum of wake-up delays (mean = late_sum / ticks)
+    uint32_t   period_min;    // shortest time between two ticks
+    uint32_t   period_max;    // longest time between two ticks
+};
+
+/* structure to return retry counters */
+struct svm_retry
+{
+    uint32_t   retries;       // commands repeated
+    uint32_t   recovered;     // commands that succeeded after retry
+    uint32_t   failures;      // commands that failed after all retries
+    uint32_t   bus_recovery;  // bus recovery attempts (stuck SDA)
+    uint32_t   absent;        // times the SVM30 dropped off the bus
+    uint32_t   resumed;       // times the SVM30 was re-initialized
+};
+
+/* capabilities of the SVM30, read by begin() (see GetCaps()) */
+struct svm_caps
+{
+    bool       sgp30;         // SGP30 ID and feature set read
+    bool       shtc1;         // SHTC1 ID read
+    uint16_t   serial[3];     // SGP30 serial number (48 bits)
+    uint16_t   feature_set;   // SGP30 feature set
+    uint8_t    type;          // product type (bit 15:12, 0 = SGP30)
+    uint8_t    level;         // product version (bit 7:0, e.g. 0x22)
+    uint16_t   shtc1_id;      // SHTC1 ID (bit 5:0 = 0x07)
+    bool       raw;           // Measure_Raw_Signals (version 0x20 or later)
+    bool       inceptive;     // inceptive baseline (version 0x22 or later)
 };
 
 
@@ -91,6 +250,30 @@ struct svm_values
 #define ERR_CMDSTATE    0x43
 #define ERR_TIMEOUT     0x50
 #define ERR_PROTOCOL    0x51
+#define ERR_NACK        0x52        // device did not acknowledge (e.g. busy)
+
+/* readiness polling : first / maximum time (uS) in between read attempts */
+#define POLL_START      1000
+#define POLL_MAX        8000
+
+/* state of a command of an asynchronous measurement */
+#define STEP_WAIT       0       // to be sent (when device is free)
+#define STEP_SENT       1       // sent, response not read
+#define STEP_OK         2       // response received
+#define STEP_FAIL       3       // failed after retries
+
+/* retry : first backoff (uS) and maximum total backoff per command. A
+ * failed command is repeated after its maximum duration (or RETRY_START
+ * if longer), doubling for each next retry. The total stays well within
+ * the 1 second measurement cadence of the SGP30. */
+#define RETRY_START     1000
+#define RETRY_BUDGET    250000
+
+/* hot-unplug : number of consecutive commands that are not acknowledged
+ * (after retries) to consider the SVM30 absent and the time (seconds)
+ * in between probes while absent */
+#define ABSENT_NACKS    3
+#define PROBE_INTERVAL  5
 
 /* source : Datasheet SVM30
  * A sensor reset can be generated using the “General Call” mode
@@ -139,13 +322,31 @@ struct svm_values
 #define SHTC1_Read_ID                   0xEFC8
 #define SHTC1_Reset                     0x805D
 
+/* command descriptors (framing, timing and feature set level) */
+# include "svm30cmd.h"
+
+/* response frames and CRC */
+# include "svm30frame.h"
+
 /***************************************************************/
 
+/* holds a (recursive) mutex for the current scope */
+class svm30_guard
+{
+  public:
+    svm30_guard(pthread_mutex_t *m) {_m = m; pthread_mutex_lock(_m);}
+    ~svm30_guard() {pthread_mutex_unlock(_m);}
+
+  private:
+    pthread_mutex_t *_m;
+};
+
 class SVM30
 {
   public:
 
     SVM30(void);
+    ~SVM30();
 
     /**
      * @brief  Enable or disable the printing of debug messages.
@@ -156,6 +357,85 @@ class SVM30
      */
     void EnableDebugging(bool act);
 
+    /**
+     * @brief  Select the I2C bus to use (/dev/i2c-N)
+     *
+     * @param bus : bus number (default I2C_DEFAULT_BUS)
+     *
+     * Only used with the i2c-dev interface (make I2C=dev). The BCM2835
+     * library selects the bus based on the board version. Must be called
+     * before begin().
+     */
+    void SetI2CBus(uint8_t bus);
+
+    /**
+     * @brief  Select the I2C transport to use
+     *
+     * @param transport : transport to use (e.g. SVM30_sim). NULL will
+     * select the default hardware transport.
+     *
+     * Must be called before begin().
+     */
+    void SetTransport(SVM30_I2C *transport);
+
+    /**
+     * @brief  Return the I2C transport in use
+     *
+     * Allows to wrap the current transport (e.g. SVM30_capture) and
+     * pass the wrapper to SetTransport().
+     */
+    SVM30_I2C * GetTransport() {return(_I2C);}
+
+    /**
+     * @brief  Enable or disable readiness polling
+     *
+     * @param act :
+     *  false : wait the fixed time after each command (default)
+     *  true : poll for the result with a short backoff
+     *
+     * The SGP30 and SHTC1 do not acknowledge a read while the result
+     * is not ready. With polling enabled, the result is read as soon as
+     * it is available instead of waiting the (double) datasheet time.
+     * If the I2C interface does not report a NACK, the driver will fall
+     * back to the fixed wait.
+     */
+    void SetReadyPolling(bool act);
+
+    /**
+     * @brief  Enable or disable pipelined acquisition in GetValues()
+     *
+     * @param act :
+     *  false : measure SGP30 and SHTC1 one after the other (default)
+     *  true : the SHTC1 converts while the SGP30 measures
+     *
+     * The SGP30 and SHTC1 are separate devices. With pipelining the
+     * SHTC1 measurement is started first, then the SGP30 measurement(s)
+     * and the results are collected when ready. A sample then takes
+     * about the time of the SGP30 measurement(s) only.
+     */
+    void SetPipelined(bool act) {_Pipelined = act;}
+
+    /**
+     * @brief  Enable or disable attach mode for begin()
+     *
+     * @param act :
+     *  false : begin() always (re)starts the SGP30 (default)
+     *  true : begin() continues with an SGP30 that is already measuring
+     *
+     * The SGP30 keeps measuring as long as it is powered. When a restart
+     * of the program sends Init_Air_Quality again, the IAQ algorithm
+     * starts over : 15 seconds of fixed values and the baseline has to
+     * be learned again. In attach mode begin() checks the ID's and the
+     * feature set first and, when the SGP30 reports a learned baseline,
+     * skips the resets and Init_Air_Quality.
+     */
+    void SetAttach(bool act) {_Attach = act;}
+
+    /**
+     * @brief : true if begin() attached to a measuring SGP30
+     */
+    bool IsAttached() {return(_Attached);}
+
     /**
      * @brief Initialize the communication & start SGP30
      *
@@ -205,7 +485,12 @@ class SVM30
     /**
      * @brief reset SGP30 or SHTC1
      *
-     * @param device : SGP30 or SHTC1
+     * @param device :
+     *  SHTC1 : soft reset of the SHTC1
+     *  SGP30 : restart of the IAQ algorithm (Init_Air_Quality) on the
+     *          next measurement. The SGP30 has no device specific reset.
+     *  RESET_ADDRESS : general call reset. This resets ALL devices on
+     *          the bus that support the general call.
      *
      * @return :
      *   true on success else false
@@ -222,6 +507,32 @@ class SVM30
      */
     bool GetFeatureSet(char *buf);
 
+    /**
+     * @brief : return the capabilities read by begin()
+     * @param caps : pointer to store the capabilities
+     *
+     * begin() and the resume after hot-unplug read the ID's and the
+     * feature set once. Commands that the SGP30 feature set does not
+     * support (see the level in svm30cmd.h) are not sent : GetValues(),
+     * Sample() and StartMeasurement() skip the raw signals of an SGP30
+     * before version 0x20, other calls fail with ERR_UNKNOWNCMD.
+     *
+     * @return :
+     *   true if both SGP30 and SHTC1 were read else false
+     */
+    bool GetCaps(struct svm_caps *caps);
+
+    /**
+     * @brief : check whether the SGP30 supports a command
+     * @param c : command descriptor (see svm30cmd.h)
+     *
+     * @return :
+     *   true if supported or the feature set is not known, else false
+     */
+    bool Supported(const svm30_cmd &c) {
+        return(c.level == 0 || ! _Caps.sgp30 || _Caps.level >= c.level);
+    }
+
     /**
      * @brief Measure SELF test on SGP30
      *
@@ -278,6 +589,62 @@ class SVM30
      *   true on success else false
      */
     bool SetBaseLines(uint32_t baseline);
+
+    /**
+     * @brief : get BOTH baselines from the cache
+     *
+     * @param baseline : pointer to baseline to store results
+     * @param maxage : read from the SGP30 if the cache is older (seconds)
+     *
+     * The cache holds the last baselines read from or written to the
+     * SGP30. Init_Air_Quality clears the cache.
+     *
+     * @return :
+     *   true on success else false
+     */
+    bool GetCachedBaseLines(uint32_t *baseline, uint16_t maxage);
+
+    /**
+     * @brief : keep the baseline in a file to restore it after a restart
+     * @param dir : directory of the file (NULL = do not store, default)
+     *
+     * Must be called before begin(). The file is named after the SGP30
+     * serial number (sgp30-XXXXXXXXXXXX.base). begin() restores a stored
+     * baseline that is younger than 7 days (datasheet), after that the
+     * baseline is stored by Checkpoint() every hour and on close(). A
+     * new baseline is only stored after the 12 hours the SGP30 needs to
+     * learn it. GetValues(), Sample() and GetResult() do not store.
+     *
+     * The file is replaced atomically (write, fsync, rename) : a crash
+     * or power loss leaves either the old or the new baseline.
+     */
+    void SetBaselineStore(const char *dir) {_StoreDir = dir;}
+
+    /**
+     * @brief : true if begin() restored the baseline from the store
+     */
+    bool IsRestored() {return(_Restored);}
+
+    /**
+     * @brief : read the baseline from the SGP30 and store it now
+     *
+     * @return :
+     *   true on success else false
+     */
+    bool SaveBaseline();
+
+    /**
+     * @brief : store the baseline when a checkpoint is due
+     * @param final : store now (if the baseline has been learned)
+     *
+     * Returns at once unless BASE_INTERVAL passed since the previous
+     * checkpoint. The measurements never store the baseline themselves :
+     * the caller schedules this call (e.g. every BASE_INTERVAL seconds),
+     * the sampler thread does it on its own. It exchanges with the
+     * SGP30 and writes the file, and is skipped (until the next call)
+     * while an asynchronous measurement is in progress.
+     */
+    void Checkpoint(bool final = false);
     
     /**
      * @brief : get Inceptivebaseline  (impact TVOC only)
@@ -311,6 +678,17 @@ class SVM30
      */
     bool SetHumidity(float humidity);
 
+    /**
+     * @brief : compensate the air quality for the measured humidity
+     * @param act : true enable, false disable (default)
+     *
+     * The absolute humidity of each temperature / humidity measurement
+     * is sent right before the next Measure_Air_Quality, only when it
+     * differs more than HUM_DEADBAND from the value sent before or that
+     * was sent more than HUM_MAXAGE seconds ago.
+     */
+    void SetHumidityComp(bool act) {_HumComp = act;}
+
     /**
      * @brief : Set temperature.
      *
@@ -322,54 +700,414 @@ class SVM30
     /**
      * @brief : read all measurement values from the sensor and store in structure
      * @param v: pointer to structure to store
-     * @param raw: if true it will try to read the raw values from the SGP30 (update 1.2)
+     * @param raw: if true it will also read the raw values from the SGP30 (update 1.2)
      *
-     * It seems that older version of the SGP30 do not support reading raw, hence the "raw" -option
-     * has been added as an option to exclude. By default it will read to stay backward compatible
+     * Older versions of the SGP30 do not support reading raw. That is now
+     * detected at begin() (see Supported()) and the raw values are skipped
+     * on such an SGP30, whatever raw is. Set raw to false to skip them on
+     * any SGP30 (saves a 25ms measurement).
+     *
+     * A field that fails does not stop the others. The quality of each
+     * field is in q_aq, q_raw and q_th (SVM_Q_*).
      *
      * @return :
-     *   true on success else false
+     *   true if at least one field was measured else false
      */
     bool GetValues(struct svm_values *v, bool raw = true);
 
+    /**
+     * @brief : measure one signal and update its fields in the structure
+     * @param v: pointer to structure to update
+     *
+     * GetAirQuality() : CO2eq, TVOC and t_aq
+     * GetRawSignals() : H2_signal, Ethanol_signal and t_raw
+     * GetTempHum()    : temperature, humidity, calculated values and t_th
+     *
+     * Other fields are not changed. The time stamps are taken from
+     * CLOCK_MONOTONIC in mS (see GetTime()). On a failure the quality
+     * (q_aq, q_raw or q_th) is set to SVM_Q_FAILED and the earlier
+     * value is kept.
+     *
+     * @return :
+     *   true on success else false
+     */
+    bool GetAirQuality(struct svm_values *v);
+    bool GetRawSignals(struct svm_values *v);
+    bool GetTempHum(struct svm_values *v);
+
+    /**
+     * @brief : set the intervals for Sample()
+     * @param s : intervals in mS (0 = do not measure)
+     *
+     * All signals are due at the first Sample() call after this.
+     */
+    void SetSchedule(const struct svm_schedule *s);
+
+    /**
+     * @brief : measure the signals that are due
+     * @param v: pointer to structure to update
+     * @param next : if not NULL, store mS until the next signal is due
+     *
+     * Each signal is measured at its own interval (see SetSchedule()).
+     * When the SVM30 is slower than the schedule, missed slots are
+     * skipped. A failed measurement is repeated at the next slot and
+     * marked in the quality of the field (SVM_Q_FAILED).
+     *
+     * @return : SVM_AQ, SVM_RAW and/or SVM_TH for the updated fields
+     */
+    uint8_t Sample(struct svm_values *v, uint32_t *next = NULL);
+
+    /**
+     * @brief : return the signals that are due and plan their next slot
+     * @param now : time in mS (see GetTime())
+     *
+     * For a caller that measures the signals itself, e.g. with
+     * StartMeasurement() on its own timer.
+     *
+     * @return : SVM_AQ, SVM_RAW and/or SVM_TH
+     */
+    uint8_t GetDue(uint64_t now);
+
+    /**
+     * @brief : return the time in mS as used for the time stamps
+     */
+    uint64_t GetTime();
+
+    /**
+     * @brief : start a thread that calls Sample() on a fixed period
+     * @param period : period in mS (default 1000, the 1Hz of the SGP30)
+     *
+     * The thread sleeps until absolute CLOCK_MONOTONIC deadlines, so
+     * the time spent on the bus or by the caller does not add drift. A
+     * tick that overruns skips the deadlines that have passed. Without
+     * a schedule (SetSchedule()) only air quality is measured.
+     *
+     * While the sampler runs, all other calls on this object wait for
+     * the current tick to finish.
+     *
+     * @return :
+     *   true on success else false
+     */
+    bool StartSampler(uint32_t period = 1000);
+
+    /**
+     * @brief : stop the sampler thread (waits for the current tick)
+     */
+    void StopSampler();
+
+    /**
+     * @brief : wait for the sampler to measure a field
+     * @param v: store the latest values
+     * @param fields : SVM_AQ, SVM_RAW and/or SVM_TH to wait for
+     * @param timeout : maximum wait in mS
+     *
+     * @param agg : if not NULL, store the statistics of all CO2eq / TVOC
+     * readings since the previous call
+     *
+     * Returns once a tick had one of the fields due (measured or not).
+     *
+     * @return : the fields updated since the previous call, 0 on
+     * timeout, failure or when the sampler is not running
+     */
+    uint8_t WaitSample(struct svm_values *v, uint8_t fields, uint32_t timeout, struct svm_aggregate *agg = NULL);
+
+    /**
+     * @brief : return the sampler thread statistics
+     */
+    void GetSamplerStats(struct svm_sampler *s);
+
+    /**
+     * @brief : return the statistics of the CO2eq / TVOC readings
+     * since the previous call (or WaitSample()) and start again
+     * @param agg : store the result
+     *
+     * The readings of the sampler and of GetResult() are included.
+     */
+    void GetAggregate(struct svm_aggregate *agg);
+
+    /**
+     * @brief : start a measurement without waiting for the result
+     * @param fields : SVM_AQ, SVM_RAW and/or SVM_TH to measure
+     *
+     * The commands are sent by Poll() when their device is free : the
+     * SHTC1 converts while the SGP30 measures, raw signals follow the
+     * air quality. Nothing blocks, except for Init_Air_Quality on the
+     * first measurement after begin() or a reset.
+     *
+     * Do not call other methods of this object (and do not run the
+     * sampler) until the measurement is done.
+     *
+     * @return :
+     *   true on success else false (busy or absent)
+     */
+    bool StartMeasurement(uint8_t fields = SVM_AQ | SVM_TH);
+
+    /**
+     * @brief : return a file descriptor that is readable when Poll()
+     * has work to do
+     *
+     * The descriptor (a CLOCK_MONOTONIC timerfd) can be used with
+     * poll(), select() or epoll next to other descriptors. It stays the
+     * same for the lifetime of the object.
+     *
+     * @return : descriptor or -1 on error
+     */
+    int ReadyFd();
+
+    /**
+     * @brief : handle the measurement started with StartMeasurement()
+     *
+     * Sends the commands that can be sent and reads the results that
+     * are ready, it never waits for a device.
+     *
+     * @return : ASYNC_IDLE, ASYNC_BUSY, ASYNC_DONE or ASYNC_FAILED
+     */
+    uint8_t Poll();
+
+    /**
+     * @brief : return the result of an asynchronous measurement
+     * @param v : pointer to structure to update (only measured fields)
+     *
+     * A field that failed is marked in its quality (SVM_Q_FAILED).
+     * After this the state is ASYNC_IDLE.
+     *
+     * @return : fields that were measured (0 = none or not done)
+     */
+    uint8_t GetResult(struct svm_values *v);
+
+    /**
+     * @brief return the retry counters
+     *
+     * @param r : store the counters
+     */
+    void GetRetryStats(struct svm_retry *r) {svm30_guard g(&_Api); *r = _Retry;}
+
+    /**
+     * @brief return whether the SVM30 is on the bus
+     *
+     * After ABSENT_NACKS consecutive commands are not acknowledged, the
+     * SVM30 is considered absent (loose connector, brown-out). GetValues()
+     * and TriggerSGP30() then fail without bus traffic, except for a
+     * probe every PROBE_INTERVAL seconds. Once the SVM30 answers, it is
+     * re-initialized with the last known baselines and humidity
+     * compensation.
+     */
+    bool IsPresent() {return(_Present);}
+
     /**
      * close library, reset pins and release memory
      */
-    void close(){I2C_close();}
+    void close(){StopSampler(); Checkpoint(true); I2C_close();}
     
   private:
 
     /** shared variables */
-    uint8_t _Receive_BUF[40];   // buffers
     uint8_t _Send_BUF[10];      // 2 command + max 6 data
-    uint8_t _Receive_BUF_Length;
     uint8_t _Send_BUF_Length;
     uint8_t _I2C_address;       // I2C address to use (SGP30 or SHTC1)
     bool     _SVM30_Debug;       // program debug level
     bool    _started;            // indicate the SGP30 measurement has started
+    uint64_t _InitTime;          // time Init_Air_Quality was sent (mS, 0 = not by us)
     bool    _SelectTemp;         // select temperature (true = celsius)
     useconds_t _wait;           // wait time after sending command
+    bool    _Polling;            // poll for result instead of fixed wait
+    bool    _Pipelined;          // overlap SHTC1 and SGP30 in GetValues()
+    bool    _Attach;             // begin() may attach to a measuring SGP30
+    bool    _Attached;           // begin() attached
+    const char *_StoreDir;       // directory of the baseline store (NULL = none)
+    time_t  _StoreFrom;          // store no baseline before (0 = store not active)
+    time_t  _StoreNext;          // next checkpoint
+    bool    _Restored;           // baseline restored by begin()
+    uint64_t _Waited;            // total time waited for devices (uS)
+    const svm30_cmd *_Cmd;       // command in send buffer
+    SVM30_I2C *_I2C;            // I2C transport in use
+    struct svm_retry _Retry;     // retry counters
+    struct svm_caps _Caps;       // capabilities (see GetCaps())
+    uint32_t _RetryWaited;       // backoff of current command (uS)
+    bool    _Present;            // SVM30 is on the bus
+    uint8_t _NackFail;           // consecutive commands not acknowledged
+    time_t  _LastProbe;          // time of last probe while absent
+    uint16_t _Baseline[2];       // last known baselines (TVOC, CO2eq)
+    uint16_t _BaseCache[2];      // last baselines read / written (TVOC, CO2eq)
+    uint64_t _BaseRead;          // time of _BaseCache (mS, 0 = empty)
+    uint16_t _Humidity;          // last humidity compensation (8.8)
+    uint64_t _HumSent;           // time _Humidity was sent (mS, 0 = never)
+    uint16_t _HumTarget;         // measured humidity to compensate (8.8)
+    bool    _HumComp;            // humidity compensation enabled
+    struct svm_schedule _Schedule; // intervals for Sample()
+    uint64_t _Due[3];            // time next sample is due (aq, raw, th)
+    pthread_mutex_t _Api;        // serializes the calls on this object
+    pthread_mutex_t _SampleLock; // protects the sampler variables below
+    pthread_cond_t _SampleCond;  // signalled after each tick
+    pthread_t _Sampler;          // sampler thread
+    bool    _SamplerRun;         // sampler thread is running
+    bool    _SamplerStop;        // request to stop the sampler
+    uint32_t _Period;            // sampler period (mS)
+    struct svm_values _Latest;   // latest values of the sampler
+    uint8_t _SampleDone;         // fields updated since WaitSample()
+    uint8_t _SampleDue;          // fields due since WaitSample()
+    struct svm_sampler _SamplerStats;
+    struct svm_aggregate _Agg;   // CO2eq / TVOC readings since WaitSample()
+    uint64_t _AggSum[2];         // sum of CO2eq / TVOC readings
+    uint16_t _AggBuf[2][AGG_MAX]; // last CO2eq / TVOC readings (median)
+    int     _TimerFd;            // timerfd of ReadyFd()
+    uint8_t _Async;              // ASYNC_* state
+    struct svm_step _Step[4];    // commands of the asynchronous measurement
+    uint8_t _Steps;              // number of commands in _Step
+    uint64_t _AsyncClock;        // last time reported to Elapsed() (uS)
+#ifdef I2CDEV
+    SVM30_i2cdev _DefaultI2C;   // default transport
+#else
+    SVM30_bcm2835 _DefaultI2C;
+#endif
 
     /** supporting routines */
     bool StartSGP30();
-    uint16_t byte_to_uint16(int x);
+    bool Resume();
+    bool Attach();
+    bool ReadCaps(struct svm_caps *caps);
+    uint8_t NotSupported(const svm30_cmd &c);
+    void StoreStart(bool running);
+    bool RestoreBaseline();
+    void StorePath(char *path, size_t len);
+    uint8_t Pipeline(struct svm_values *v, bool raw);
+    uint8_t MeasureAirQuality(uint16_t (&aq)[2]);
+    void StoreAirQuality(struct svm_values *v, const uint16_t (&aq)[2]);
+    void StoreRawSignals(struct svm_values *v, const uint16_t (&rs)[2]);
+    void StoreTempHum(struct svm_values *v, const uint16_t (&th)[2]);
+    void StoreFailed(struct svm_values *v, uint8_t field, uint8_t ret);
+    bool Due(uint8_t i, uint32_t interval, uint64_t now);
+    uint8_t SampleAt(struct svm_values *v, uint32_t *next, uint64_t now, uint8_t *due);
+    static void *SamplerThread(void *arg);
+    void Sampler();
+    void Aggregate(const struct svm_values *v);
+    void AddStep(const svm30_cmd &c, uint8_t field, uint16_t param = 0);
+    void Step(struct svm_step *s, uint64_t now);
+    void ArmTimer(uint64_t due);
+    void Reduce(struct svm_aggregate *agg);
     void calc_absolute_humidity(struct svm_values *v);
     uint16_t ConvAbsolute(float AbsoluteHumidity);
+    bool HumidityDue();
+    void SendHumidity();
+    void HumiditySent(uint16_t humidity);
     bool SetBaseLine(uint16_t baseline, bool tvoc);
     bool GetBaseLine(uint16_t *baseline, bool tvoc);
+    bool ReadBaseLines(uint16_t (&base)[2]);
+    bool WriteBaseLines(const uint16_t (&base)[2]);
+    void CacheBaseLines(const uint16_t (&base)[2]);
     void calc_dewpoint(struct svm_values *v);
     void computeHeatIndex(struct svm_values *v);
 
+    /** command helpers (framing is taken from the descriptor in svm30cmd.h)
+     *
+     * Each attempt is one exchange (command, wait, response) with the bus
+     * locked, see SVM30_I2C::Lock(), BusLock() and DeviceLock(). The device
+     * lock is kept during the wait, so no other exchange reaches the
+     * device between command and response. As all state of an
+     * exchange is kept in the object, SVM30 objects on different buses or
+     * multiplexer channels can be used from different threads. */
+
+    // claim / release the bus for one exchange
+    void Claim() {_I2C->DeviceLock(); _I2C->BusLock(); _I2C->Lock();}
+    void Release() {_I2C->Unlock(); _I2C->BusUnlock(); _I2C->DeviceUnlock();}
+
+    // send command without parameters (no response expected)
+    template <const svm30_cmd &C> uint8_t Command() {
+        static_assert(C.param == 0, "command needs parameter words");
+        static_assert(C.resp == 0, "command has a response, use Request<>()");
+        uint8_t ret, attempt = 0;
+
+        if (! Supported(C)) return(NotSupported(C));
+
+        do {
+            Claim();
+            PrepSendBuffer(C);
+            ret = SendToSVM();
+            Release();
+        } while (Retry(C, ret, attempt));
+
+        return(ret);
+    }
+
+    // send command with C.param parameter words (no response expected)
+    template <const svm30_cmd &C> uint8_t Command(const uint16_t (&param)[C.param]) {
+        static_assert(C.resp == 0, "command has a response, use Request<>()");
+        uint8_t ret, attempt = 0;
+
+        if (! Supported(C)) return(NotSupported(C));
+
+        do {
+            Claim();
+            PrepSendBuffer(C, param);
+            ret = SendToSVM();
+            Release();
+        } while (Retry(C, ret, attempt));
+
+        return(ret);
+    }
+
+    // send command and read C.resp response words
+    template <const svm30_cmd &C> uint8_t Request(uint16_t (&resp)[C.resp]) {
+        static_assert(C.param == 0, "command needs parameter words");
+        svm30_frame<C.resp> frame;
+        uint8_t ret, attempt = 0;
+
+        if (! Supported(C)) return(NotSupported(C));
+
+        do {
+            Claim();
+            PrepSendBuffer(C);
+            ret = RequestFromSVM(frame.raw, sizeof(frame.raw));
+            Release();
+        } while (Retry(C, ret, attempt));
+
+        if (ret != ERR_OK) return(ret);
+
+        frame.Decode(resp);
+        return(ERR_OK);
+    }
+
+    /* pipelining : start a command without waiting and collect the
+     * response later, so the wait overlaps with other commands. The bus
+     * must be claimed by the caller and a failure is not repeated. */
+
+    // start command C, mark is needed for Collect<C>()
+    template <const svm30_cmd &C> uint8_t Start(uint64_t &mark) {
+        static_assert(C.param == 0, "command needs parameter words");
+        static_assert(C.resp > 0, "command has no response, use Command<>()");
+        if (! Supported(C)) return(NotSupported(C));
+        PrepSendBuffer(C);
+        mark = _Waited;
+        return(SendToSVM(false));
+    }
+
+    // read the C.resp response words of a command started with Start<C>()
+    template <const svm30_cmd &C> uint8_t Collect(uint64_t mark, uint16_t (&resp)[C.resp]) {
+        svm30_frame<C.resp> frame;
+        uint8_t ret;
+
+        SetCommand(C);
+        ret = CollectFromSVM(frame.raw, sizeof(frame.raw), _Waited - mark);
+        if (ret == ERR_OK) frame.Decode(resp);
+
+        return(ret);
+    }
+
     /** I2C communication */
-    void PrepSendBuffer(uint8_t I2C_add, uint16_t cmd, char *param = NULL, uint8_t len = 0);
-    uint8_t RequestFromSVM(uint8_t count);
-    uint8_t ReadFromSVM(uint8_t cnt);
-    uint8_t SendToSVM();
-    uint8_t CalcCrC(uint8_t data[2]);
+    bool Retry(const svm30_cmd &c, uint8_t ret, uint8_t &attempt, useconds_t *backoff = NULL);
+    void SetCommand(const svm30_cmd &c);
+    void PrepSendBuffer(const svm30_cmd &c, const uint16_t *param = NULL);
+    uint8_t RequestFromSVM(uint8_t *buf, uint8_t len);
+    uint8_t ReadFromSVM(uint8_t *buf, uint8_t len, bool combined = false);
+    uint8_t SendToSVM(bool settle = true);
+    uint8_t PollFromSVM(uint8_t *buf, uint8_t len, useconds_t elapsed = 0);
+    uint8_t CollectFromSVM(uint8_t *buf, uint8_t len, useconds_t elapsed);
     bool I2C_init();
     void I2C_close();
     uint8_t I2C_write();
     uint8_t I2C_read(char *buf, uint8_t len);
+    uint8_t I2C_transfer(char *buf, uint8_t len);
+    void I2C_wait(useconds_t us);
 
     /********************************************************************
      * FOLLOWING CODE IS TAKEN FROM
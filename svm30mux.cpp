@@ -0,0 +1,255 @@
+/**
+ * SVM30 TCA9548A I2C multiplexer
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *********************************************************************
+ */
+
+# include "svm30mux.h"
+# include "svm30lib.h"
+# include <time.h>
+
+/**
+ * @brief : get monotonic time in uS
+ */
+static uint64_t mux_time() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/*****************************************************************
+ * multiplexer
+ ****************************************************************/
+
+/**
+ * @brief constructor and initialize variables
+ */
+SVM30_mux::SVM30_mux(void) {
+    uint8_t i;
+
+    _Address = 0;
+    _I2C = NULL;
+    _Selected = MUX_NONE;
+    _Taken = 0;
+    _Open = 0;
+    memset(&_Stats, 0, sizeof(_Stats));
+
+    for (i = 0; i < MUX_CHANNELS; i++) {
+        _Port[i]._Mux = this;
+        _Port[i]._Channel = i;
+    }
+}
+
+/**
+ * @brief : set the multiplexer address and the bus transport
+ *
+ * @param address : I2C address of TCA9548A (0x71 - 0x77)
+ * @param transport : transport of the bus the TCA9548A is on
+ *
+ * @return :
+ *   true on success, false if the address is not valid
+ */
+bool SVM30_mux::SetMux(uint8_t address, SVM30_I2C *transport) {
+
+    if (address < MUX_ADDR_MIN || address > MUX_ADDR_MAX || transport == NULL)
+        return(false);
+
+    _Address = address;
+    _I2C = transport;
+    _Selected = MUX_NONE;
+
+    return(true);
+}
+
+/**
+ * @brief : return the transport for a channel
+ *
+ * @param channel : 0 - 7
+ */
+SVM30_I2C * SVM30_mux::Channel(uint8_t channel) {
+
+    if (channel >= MUX_CHANNELS) return(NULL);
+
+    return(&_Port[channel]);
+}
+
+/**
+ * @brief : open the bus when the first channel is opened
+ *
+ * @param debug : enable debug messages of bus transport
+ *
+ * @return :
+ *   true on success else false
+ */
+bool SVM30_mux::Open(bool debug) {
+
+    if (_I2C == NULL) return(false);
+
+    if (_Open == 0) {
+        _I2C->EnableDebugging(debug);
+        if (! _I2C->Open()) return(false);
+
+        // channel selection after power-up / other program is unknown
+        _Selected = MUX_NONE;
+    }
+
+    _Open++;
+
+    return(true);
+}
+
+/**
+ * @brief : close the bus when the last channel is closed
+ */
+void SVM30_mux::Close() {
+
+    if (_Open == 0) return;
+
+    if (--_Open == 0) _I2C->Close();
+}
+
+/**
+ * @brief : select channel, unless already selected
+ *
+ * @param channel : channel to select
+ *
+ * @return : ERR_OK or error
+ */
+uint8_t SVM30_mux::Select(uint8_t channel) {
+    uint8_t reg, ret;
+    uint64_t start;
+    uint32_t taken;
+
+    // the cache is only valid while this process held the bus without a
+    // break : another process may have switched the multiplexer
+    taken = _I2C->BusTaken();
+    if (taken != _Taken) {
+        _Selected = MUX_NONE;
+        _Taken = taken;
+    }
+
+    if (channel == _Selected) {
+        _Stats.skipped++;
+        return(ERR_OK);
+    }
+
+    reg = 1 << channel;
+    start = mux_time();
+
+    ret = _I2C->Write(_Address, &reg, 1);
+
+    _Stats.switch_time += mux_time() - start;
+
+    if (ret != ERR_OK) {
+        // state of multiplexer unknown
+        _Selected = MUX_NONE;
+        _Stats.failed++;
+        return(ret);
+    }
+
+    _Selected = channel;
+    _Stats.switches++;
+
+    return(ERR_OK);
+}
+
+/*****************************************************************
+ * multiplexer channel
+ ****************************************************************/
+
+bool SVM30_muxport::Open() {
+    return(_Mux->Open(_I2C_Debug));
+}
+
+void SVM30_muxport::Close() {
+    _Mux->Close();
+}
+
+uint8_t SVM30_muxport::Write(uint8_t address, uint8_t *buf, uint8_t len) {
+    uint8_t ret = _Mux->Select(_Channel);
+
+    if (ret != ERR_OK) return(ret);
+
+    return(_Mux->_I2C->Write(address, buf, len));
+}
+
+uint8_t SVM30_muxport::Read(uint8_t address, uint8_t *buf, uint8_t len) {
+    uint8_t ret = _Mux->Select(_Channel);
+
+    if (ret != ERR_OK) return(ret);
+
+    return(_Mux->_I2C->Read(address, buf, len));
+}
+
+uint8_t SVM30_muxport::Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen) {
+    uint8_t ret = _Mux->Select(_Channel);
+
+    if (ret != ERR_OK) return(ret);
+
+    return(_Mux->_I2C->Transfer(address, wbuf, wlen, rbuf, rlen));
+}
+
+void SVM30_muxport::Delay(useconds_t us) {
+    _Mux->_I2C->Delay(us);
+}
+
+void SVM30_muxport::Elapsed(useconds_t us) {
+    _Mux->_I2C->Elapsed(us);
+}
+
+void SVM30_muxport::Lock() {
+    _Mux->_I2C->Lock();
+}
+
+void SVM30_muxport::Unlock() {
+    _Mux->_I2C->Unlock();
+}
+
+void SVM30_muxport::BusLock() {
+    _Mux->_I2C->BusLock();
+}
+
+void SVM30_muxport::BusUnlock() {
+    _Mux->_I2C->BusUnlock();
+}
+
+void SVM30_muxport::GetBusStats(struct bus_stats *st) {
+    _Mux->_I2C->GetBusStats(st);
+}
+
+uint32_t SVM30_muxport::BusTaken() {
+    return(_Mux->_I2C->BusTaken());
+}
+
+/**
+ * @brief : recover the bus. The channel is selected again on the next
+ * transaction.
+ */
+bool SVM30_muxport::Recover() {
+    _Mux->_Selected = MUX_NONE;
+    return(_Mux->_I2C->Recover());
+}
@@ -0,0 +1,149 @@
+/**
+ * SVM30 TCA9548A I2C multiplexer Header file
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * Every SVM30 has the same fixed addresses (SGP30 0x58, SHTC1 0x70).
+ * To connect more than one module to a bus, each module is placed on a
+ * channel of a TCA9548A multiplexer :
+ *
+ *      SVM30_i2cdev Bus;           // or any other transport
+ *      SVM30_mux Mux;
+ *      SVM30 Sensor[8];
+ *
+ *      Mux.SetMux(0x71, &Bus);
+ *      for (i = 0; i < 8; i++) Sensor[i].SetTransport(Mux.Channel(i));
+ *
+ * The multiplexer remembers the selected channel, so a channel is only
+ * switched when a transaction is for a module on another channel. This
+ * works because all modules on the bus share the one SVM30_mux. Once
+ * this process has released the cross-process bus lock, another program
+ * may have switched the channel : the channel is then written again on
+ * the next transaction (see SVM30_I2C::BusTaken()). The channels lock
+ * the bus transport, so the modules can be read from different threads.
+ *
+ * The TCA9548A address range is 0x70 - 0x77. 0x70 is taken by the SHTC1,
+ * so A0 - A2 must be strapped for 0x71 - 0x77. Use one multiplexer per
+ * bus : a second TCA9548A on the same bus would keep its channel
+ * enabled while the first is switched. For more modules, cascade a
+ * multiplexer on a channel (pass Mux.Channel(n) as its transport).
+ *********************************************************************
+ */
+#ifndef SVM30_MUX_H
+#define SVM30_MUX_H
+
+# include "svm30i2c.h"
+
+#define MUX_CHANNELS    8
+#define MUX_ADDR_MIN    0x71        // 0x70 is the SHTC1
+#define MUX_ADDR_MAX    0x77
+#define MUX_NONE        0xff        // no / unknown channel selected
+
+/* multiplexer statistics */
+struct mux_stats
+{
+    uint32_t switches;              // channel switches
+    uint32_t skipped;               // transactions without switch
+    uint32_t failed;                // failed channel switches
+    uint64_t switch_time;           // total time switching (uS)
+};
+
+class SVM30_mux;
+
+/* one channel of the multiplexer, used as transport by an SVM30 */
+class SVM30_muxport : public SVM30_I2C
+{
+  public:
+
+    bool Open();
+    void Close();
+    uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen);
+    void Delay(useconds_t us);
+    void Elapsed(useconds_t us);
+    bool Recover();
+    void Lock();
+    void Unlock();
+    void BusLock();
+    void BusUnlock();
+    void GetBusStats(struct bus_stats *st);
+    uint32_t BusTaken();
+
+  private:
+    friend class SVM30_mux;
+    SVM30_mux *_Mux;
+    uint8_t _Channel;
+};
+
+class SVM30_mux
+{
+  public:
+
+    SVM30_mux(void);
+
+    /**
+     * @brief set the multiplexer address and the bus transport
+     *
+     * @param address : I2C address of TCA9548A (0x71 - 0x77)
+     * @param transport : transport of the bus the TCA9548A is on
+     *
+     * @return :
+     *   true on success, false if the address is not valid
+     */
+    bool SetMux(uint8_t address, SVM30_I2C *transport);
+
+    /**
+     * @brief return the transport for a channel
+     *
+     * @param channel : 0 - 7
+     *
+     * @return : transport to pass to SVM30::SetTransport(), or NULL if
+     * the channel is not valid
+     */
+    SVM30_I2C * Channel(uint8_t channel);
+
+    /**
+     * @brief : return the switch statistics
+     */
+    void GetStats(struct mux_stats *st) {*st = _Stats;}
+
+  private:
+    friend class SVM30_muxport;
+
+    uint8_t _Address;               // I2C address of TCA9548A
+    SVM30_I2C *_I2C;                // transport of the bus
+    uint8_t _Selected;              // selected channel (cache)
+    uint32_t _Taken;                // BusTaken() the cache is valid for
+    uint8_t _Open;                  // number of channels opened
+    struct mux_stats _Stats;
+    SVM30_muxport _Port[MUX_CHANNELS];
+
+    bool Open(bool debug);
+    void Close();
+    uint8_t Select(uint8_t channel);
+};
+
+#endif /* SVM30_MUX_H */
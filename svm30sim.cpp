@@ -0,0 +1,453 @@
+/**
+ * SVM30 simulator
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *********************************************************************
+ */
+
+# include "svm30sim.h"
+# include "svm30lib.h"
+
+/* time (uS) for the SGP30 to start after reset / power-up */
+#define SIM_WARMUP      15000000
+
+/* baselines learned by the simulated SGP30 after warm-up */
+#define SIM_BASE_TVOC   0x9034
+#define SIM_BASE_CO2    0x8A1D
+
+/* serial numbers */
+#define SIM_SGP30_ID0   0x0000
+#define SIM_SGP30_ID1   0x0148
+#define SIM_SGP30_ID2   0x2C6A
+#define SIM_SHTC1_ID    0x0807      // bit 5:0 = 0x07 for SHTC1
+
+/**
+ * @brief constructor and initialize variables
+ */
+SVM30_sim::SVM30_sim(void) {
+    _Clock = 0;
+    _Mux = _MuxReg = 0;
+    _Connected = true;
+    _FeatureSet = 0x0022;
+    _Temperature = 21.5;
+    _RelHumidity = 45.0;
+    Reset();
+}
+
+/**
+ * @brief : set the environment the SHTC1 will measure
+ *
+ * @param temperature : in Celsius
+ * @param humidity : relative humidity in %
+ */
+void SVM30_sim::SetEnvironment(float temperature, float humidity) {
+    _Temperature = temperature;
+    _RelHumidity = humidity;
+}
+
+/**
+ * @brief : start simulation
+ *
+ * @return : true
+ */
+bool SVM30_sim::Open() {
+    if (_I2C_Debug) printf("Using simulated SVM30\n");
+    return(true);
+}
+
+/**
+ * @brief : connect / disconnect the SVM30
+ */
+void SVM30_sim::SetConnected(bool act) {
+
+    // power-up
+    if (act && ! _Connected) {
+        Reset();
+        _SGP.ready = _SHT.ready = GetClock() + 600;
+    }
+
+    _Connected = act;
+}
+
+/**
+ * @brief : power-up / general call reset of both devices
+ */
+void SVM30_sim::Reset() {
+    memset(&_SGP, 0x0, sizeof(struct sim_device));
+    memset(&_SHT, 0x0, sizeof(struct sim_device));
+
+    _Init = false;
+    _InitTime = 0;
+    _Baseline[0] = _Baseline[1] = 0;
+    _Inceptive = 0;
+    _Humidity = 0;
+    _Samples = 0;
+}
+
+/**
+ * @brief : add the time on the bus at 100Khz
+ * @param len : number of data bytes (address byte is added)
+ *
+ * each byte takes 9 clocks (8 bits + ACK) of 10uS
+ */
+void SVM30_sim::BusTime(uint8_t len) {
+    _Clock += (len + 1) * 90;
+}
+
+/**
+ * @brief : advance the clock to a time, unless it is already past it
+ * @param t : time (uS)
+ */
+void SVM30_sim::ClockTo(uint64_t t) {
+    uint64_t now = _Clock.load();
+
+    while (now < t && ! _Clock.compare_exchange_weak(now, t));
+}
+
+/**
+ * @brief : check the parameters received with a command
+ * @param buf : received bytes (command + parameters)
+ * @param len : number of received bytes
+ * @param words : number of parameter words expected
+ *
+ * @return : true if length and CRC are correct
+ */
+bool SVM30_sim::CheckParam(uint8_t *buf, uint8_t len, uint8_t words) {
+
+    if (len != 2 + words * 3) return(false);
+
+    for (uint8_t i = 2; i < len; i += 3) {
+        if (svm30_crc8(&buf[i]) != buf[i + 2]) return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief : store response of a command
+ * @param d : device
+ * @param words : words to respond
+ * @param cnt : number of words
+ * @param wait : time (uS) before response is ready
+ */
+void SVM30_sim::SetResponse(struct sim_device *d, uint16_t *words, uint8_t cnt, uint32_t wait) {
+    uint8_t i, j = 0;
+
+    for (i = 0; i < cnt; i++) {
+        d->resp[j++] = words[i] >> 8;
+        d->resp[j++] = words[i] & 0xff;
+        d->resp[j] = svm30_crc8(&d->resp[j - 2]);
+        j++;
+    }
+
+    d->resp_len = j;
+    d->ready = GetClock() + wait;
+}
+
+/**
+ * @brief : handle SGP30 command
+ * @param buf : received bytes (command + parameters)
+ * @param len : number of received bytes
+ *
+ * timing is the typical time from the datasheet
+ *
+ * @return : ERR_OK or ERR_NACK (not acknowledged)
+ */
+uint8_t SVM30_sim::SGP30_cmd(uint8_t *buf, uint8_t len) {
+    uint16_t w[3];
+    uint64_t now = GetClock();
+    bool warmup = now - _InitTime < SIM_WARMUP;
+
+    switch(buf[0] << 8 | buf[1]) {
+
+        case SGP30_Init_Air_Quality:
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+            _Init = true;
+            _InitTime = now;
+            _Samples = 0;
+            SetResponse(&_SGP, w, 0, 2000);
+            break;
+
+        case SGP30_Measure_Air_Quality:
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+
+            if (! _Init || warmup) {
+                w[0] = 400;     // CO2eq
+                w[1] = 0;       // TVOC
+            }
+            else {
+                w[0] = 400 + (_Samples * 7) % 250;
+                w[1] = (_Samples * 3) % 120;
+            }
+            _Samples++;
+            SetResponse(&_SGP, w, 2, 10000);
+            break;
+
+        case SGP30_Get_Baseline:
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+
+            // learned after warm-up unless restored before
+            if (_Init && ! warmup) {
+                if (_Baseline[0] == 0) _Baseline[0] = SIM_BASE_TVOC;
+                if (_Baseline[1] == 0) _Baseline[1] = SIM_BASE_CO2;
+            }
+            w[0] = _Baseline[0];
+            w[1] = _Baseline[1];
+            SetResponse(&_SGP, w, 2, 10000);
+            break;
+
+        case SGP30_Set_Baseline:
+            // both TVOC and CO2eq (driver order), the SGP30 does not
+            // take a single baseline
+            if (! CheckParam(buf, len, 2)) return(ERR_NACK);
+            _Baseline[0] = buf[2] << 8 | buf[3];
+            _Baseline[1] = buf[5] << 8 | buf[6];
+
+            SetResponse(&_SGP, w, 0, 10000);
+            break;
+
+        case SGP30_Set_Humidity:
+            if (! CheckParam(buf, len, 1)) return(ERR_NACK);
+            _Humidity = buf[2] << 8 | buf[3];
+            SetResponse(&_SGP, w, 0, 1000);
+            break;
+
+        case SGP30_Measure_Test:
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+            w[0] = SGP30_TestOK;
+            SetResponse(&_SGP, w, 1, 200000);
+            break;
+
+        case SGP30_Get_Feature_Set:
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+            w[0] = _FeatureSet;
+            SetResponse(&_SGP, w, 1, 1000);
+            break;
+
+        case SGP30_Measure_Raw_Signals:
+            // older product versions (level 9) do not support raw
+            if ((_FeatureSet & 0xff) < 0x20) return(ERR_NACK);
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+            w[0] = 13600 + _Samples % 50;   // H2
+            w[1] = 19200 - _Samples % 50;   // Ethanol
+            SetResponse(&_SGP, w, 2, 20000);
+            break;
+
+        case SGP30_Get_tvoc_inceptive_baseline:
+            if ((_FeatureSet & 0xff) < 0x22) return(ERR_NACK);
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+            w[0] = _Inceptive;
+            SetResponse(&_SGP, w, 1, 10000);
+            break;
+
+        case SGP30_Set_tvoc_inceptive_baseline:
+            if ((_FeatureSet & 0xff) < 0x22) return(ERR_NACK);
+            if (! CheckParam(buf, len, 1)) return(ERR_NACK);
+            _Inceptive = buf[2] << 8 | buf[3];
+            SetResponse(&_SGP, w, 0, 10000);
+            break;
+
+        case SGP30_Read_ID:
+            if (! CheckParam(buf, len, 0)) return(ERR_NACK);
+            w[0] = SIM_SGP30_ID0;
+            w[1] = SIM_SGP30_ID1;
+            w[2] = SIM_SGP30_ID2;
+            SetResponse(&_SGP, w, 3, 500);
+            break;
+
+        default:
+            return(ERR_NACK);
+    }
+
+    _SGP.stretch = false;
+    return(ERR_OK);
+}
+
+/**
+ * @brief : handle SHTC1 command
+ * @param buf : received bytes (command)
+ * @param len : number of received bytes
+ *
+ * @return : ERR_OK or ERR_NACK (not acknowledged)
+ */
+uint8_t SVM30_sim::SHTC1_cmd(uint8_t *buf, uint8_t len) {
+    uint16_t w[2], t, h;
+    uint16_t cmd = buf[0] << 8 | buf[1];
+
+    if (len != 2) return(ERR_NACK);
+
+    // Temperature = 175 * S_T / 2^16 - 45, Humidity = 100 * S_RH / 2^16
+    t = (uint16_t) ((_Temperature + 45) * 65536 / 175);
+    h = (uint16_t) (_RelHumidity * 65536 / 100);
+
+    switch(cmd) {
+
+        case SHTC1_Read_Temp_First:
+        case SHTC1_CS_Read_Temp_First:
+            w[0] = t;
+            w[1] = h;
+            SetResponse(&_SHT, w, 2, 10800);
+            break;
+
+        case SHTC1_Read_Humidity_First:
+        case SHTC1_CS_Read_Humidity_First:
+            w[0] = h;
+            w[1] = t;
+            SetResponse(&_SHT, w, 2, 10800);
+            break;
+
+        case SHTC1_Read_ID:
+            w[0] = SIM_SHTC1_ID;
+            SetResponse(&_SHT, w, 1, 0);
+            break;
+
+        case SHTC1_Reset:
+            SetResponse(&_SHT, w, 0, 240);
+            break;
+
+        default:
+            return(ERR_NACK);
+    }
+
+    _SHT.stretch = (cmd == SHTC1_CS_Read_Temp_First || cmd == SHTC1_CS_Read_Humidity_First);
+    return(ERR_OK);
+}
+
+/**
+ * @brief : write to simulated device
+ *
+ * @param address : I2C address of device
+ * @param buf : bytes to write
+ * @param len : number of bytes to write
+ *
+ * @return : ERR_OK or ERR_NACK (not acknowledged)
+ */
+uint8_t SVM30_sim::Write(uint8_t address, uint8_t *buf, uint8_t len) {
+    uint64_t now;
+
+    BusTime(len);
+    now = GetClock();
+
+    if (len < 1) return(ERR_NACK);
+
+    if (_Mux) {
+        if (address == _Mux) {
+            _MuxReg = buf[len - 1];
+            return(ERR_OK);
+        }
+
+        // no channel enabled : SVM30 is not connected
+        if (_MuxReg == 0) return(ERR_NACK);
+    }
+
+    if (! _Connected) return(ERR_NACK);
+
+    switch(address) {
+
+        case RESET_ADDRESS:                 // general call
+            if (buf[0] != RESET_CMD) return(ERR_NACK);
+            Reset();
+            _SGP.ready = _SHT.ready = now + 600;
+            return(ERR_OK);
+
+        case SGP30_ADDRESS:
+            // busy : not acknowledged
+            if (now < _SGP.ready || len < 2) return(ERR_NACK);
+            return(SGP30_cmd(buf, len));
+
+        case SHTC1_ADDRESS:
+            if (now < _SHT.ready || len < 2) return(ERR_NACK);
+            return(SHTC1_cmd(buf, len));
+    }
+
+    // no device on this address
+    return(ERR_NACK);
+}
+
+/**
+ * @brief : read from simulated device
+ *
+ * @param address : I2C address of device
+ * @param buf : buffer to store bytes
+ * @param len : number of bytes to read
+ *
+ * A read header is not acknowledged while a measurement is in progress
+ * or when there is nothing to read. Reading more than available will
+ * return 0xFF.
+ *
+ * @return : ERR_OK or ERR_NACK (not acknowledged)
+ */
+uint8_t SVM30_sim::Read(uint8_t address, uint8_t *buf, uint8_t len) {
+    struct sim_device *d;
+    uint64_t now;
+    uint8_t i;
+
+    if ((_Mux && _MuxReg == 0) || ! _Connected) d = NULL;
+    else if (address == SGP30_ADDRESS) d = &_SGP;
+    else if (address == SHTC1_ADDRESS) d = &_SHT;
+    else d = NULL;
+
+    if (d == NULL) {
+        BusTime(0);
+        return(ERR_NACK);
+    }
+
+    now = GetClock();
+
+    // clock stretching : wait for measurement to complete
+    if (d->stretch && now < d->ready) {
+        ClockTo(d->ready);
+        now = d->ready;
+    }
+
+    if (d->resp_len == 0 || now < d->ready) {
+        BusTime(0);
+        return(ERR_NACK);
+    }
+
+    BusTime(len);
+
+    for (i = 0; i < len; i++) {
+        if (i < d->resp_len) buf[i] = d->resp[i];
+        else buf[i] = 0xff;
+    }
+
+    d->resp_len = 0;
+    return(ERR_OK);
+}
+
+/**
+ * @brief : write and read in one transaction (repeated start)
+ *
+ * @return : ERR_OK or ERR_NACK
+ */
+uint8_t SVM30_sim::Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen) {
+    uint8_t ret;
+
+    ret = Write(address, wbuf, wlen);
+    if (ret != ERR_OK) return(ret);
+
+    return(Read(address, rbuf, rlen));
+}
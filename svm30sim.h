@@ -0,0 +1,146 @@
+/**
+ * SVM30 simulator Header file
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **********************************************************************
+ * Version 1.0 / October 2026
+ * - Initial version by paulvha
+ *
+ * An in-process model of the SGP30 (0x58) and SHTC1 (0x70) as found on
+ * the SVM30. It answers every command in svm30lib.h with correct CRC's
+ * and datasheet timing, so the complete driver can be exercised without
+ * hardware.
+ *
+ * The simulator keeps its own clock. Delay() advances that clock instead
+ * of sleeping and every byte on the bus adds the 100Khz transfer time.
+ * As such the driver runs at full (wire) speed, while the devices still
+ * see the time they need : a read before a measurement is ready is not
+ * acknowledged and the first 15 seconds after Init_Air_Quality return
+ * the warm-up values (400 ppm CO2eq, 0 ppb TVOC, zero baselines).
+ *
+ * The driver calls Delay() with the bus unlocked (I2C_wait()), so
+ * threads on multiplexer ports of one simulator advance the clock at
+ * the same time. The clock is atomic and every check reads it once.
+ *********************************************************************
+ */
+#ifndef SVM30_SIM_H
+#define SVM30_SIM_H
+
+# include "svm30i2c.h"
+# include <atomic>
+
+/* simulated device state */
+struct sim_device
+{
+    uint8_t  resp[10];          // pending response (words + CRC)
+    uint8_t  resp_len;          // length of pending response
+    uint64_t ready;             // clock (uS) when response is ready
+    bool     stretch;           // clock stretching until ready
+};
+
+class SVM30_sim : public SVM30_I2C
+{
+  public:
+
+    SVM30_sim(void);
+
+    /**
+     * @brief set the SGP30 feature set to report
+     *
+     * @param fs : feature set (default 0x0022)
+     *
+     * A product version below 0x20 (like level 9) does not acknowledge
+     * Measure_Raw_Signals, level 34 (0x22) is needed for the inceptive
+     * baseline commands.
+     */
+    void SetFeatureSet(uint16_t fs) {_FeatureSet = fs;}
+
+    /**
+     * @brief set the environment the SHTC1 will measure
+     *
+     * @param temperature : in Celsius
+     * @param humidity : relative humidity in %
+     */
+    void SetEnvironment(float temperature, float humidity);
+
+    /**
+     * @brief : return the simulated clock in micro seconds
+     */
+    uint64_t GetClock() {return(_Clock.load());}
+
+    /**
+     * @brief place the SVM30 behind a simulated TCA9548A
+     *
+     * @param address : I2C address of the multiplexer (0 = none)
+     *
+     * The SVM30 can only be reached when a channel is enabled.
+     */
+    void SetMux(uint8_t address) {_Mux = address; _MuxReg = 0;}
+
+    /**
+     * @brief connect / disconnect the SVM30 (hot-unplug)
+     *
+     * A disconnected SVM30 does not acknowledge anything. On connect
+     * both devices start as after power-up.
+     */
+    void SetConnected(bool act);
+
+    bool Open();
+    void Close() {}
+    uint8_t Write(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Read(uint8_t address, uint8_t *buf, uint8_t len);
+    uint8_t Transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen, uint8_t *rbuf, uint8_t rlen);
+    void Delay(useconds_t us) {_Clock += us;}
+    void Elapsed(useconds_t us) {_Clock += us;}
+    bool Recover() {_Clock += 100; return(true);}   // 9 clocks + STOP
+
+  private:
+    std::atomic<uint64_t> _Clock;   // simulated time in uS
+    struct sim_device _SGP;     // SGP30 state
+    struct sim_device _SHT;     // SHTC1 state
+    uint8_t  _Mux;              // address TCA9548A (0 = none)
+    uint8_t  _MuxReg;           // enabled channels
+    bool     _Connected;        // SVM30 connected to bus
+
+    /** SGP30 */
+    uint16_t _FeatureSet;
+    bool     _Init;             // Init_Air_Quality received
+    uint64_t _InitTime;         // clock at Init_Air_Quality
+    uint16_t _Baseline[2];      // TVOC, CO2eq (same order as the driver)
+    uint16_t _Inceptive;        // inceptive TVOC baseline
+    uint16_t _Humidity;         // absolute humidity 8.8
+    uint32_t _Samples;          // number of air quality measurements
+
+    /** SHTC1 */
+    float    _Temperature;
+    float    _RelHumidity;
+
+    void Reset();
+    void BusTime(uint8_t len);
+    void ClockTo(uint64_t t);
+    bool CheckParam(uint8_t *buf, uint8_t len, uint8_t words);
+    void SetResponse(struct sim_device *d, uint16_t *words, uint8_t cnt, uint32_t wait);
+    uint8_t SGP30_cmd(uint8_t *buf, uint8_t len);
+    uint8_t SHTC1_cmd(uint8_t *buf, uint8_t len);
+};
+
+#endif /* SVM30_SIM_H */